@@ -0,0 +1,354 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "dither.h"
+#include "random.h"
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#elif HAVE_ARM_NEON
+# include <arm_neon.h>
+#endif
+
+#define MAX_ORDER		9
+/* the number of samples for which noise is generated at once */
+#define NOISE_BLOCK		1024
+
+typedef void (*_flat16_fn)(int16_t*, const float*, const uint32_t*, size_t);
+
+struct _aaxDither
+{
+   unsigned int tracks;
+   unsigned int track;		/* track of the next sample */
+   unsigned int bits;		/* 8 or 16 */
+   unsigned int order;		/* noise shaping filter length */
+   const float *coeffs;
+   float scale;
+   float min, max;
+   float *err;			/* tracks x MAX_ORDER, most recent first */
+   _flat16_fn flat16;
+
+   _aax_random_stream_t rng;
+   uint32_t noise[NOISE_BLOCK];
+};
+
+static const struct {
+   const char *name;
+   unsigned int order;
+   float coeffs[MAX_ORDER];
+} _shape[AAX_DITHER_MAX] = {
+   { "off",        0, { 0.0f } },
+   { "tpdf",       0, { 0.0f } },
+   { "shaped",     1, { 1.0f } },
+   { "lipshitz",   5, { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f } },
+   { "wannamaker", 9, { 2.412f, -3.370f, 3.937f, -4.174f, 3.353f, -2.205f,
+                        1.281f, -0.569f, 0.0847f } }
+};
+
+/*
+ * The difference of the two 16-bit halves of a random number has a
+ * triangular distribution between -1 and 1 LSB.
+ */
+#define TPDF_SCALE		(1.0f/65536.0f)
+
+static inline float
+_tpdf(uint32_t r) {
+   return (float)((int32_t)(r & 0xFFFF) - (int32_t)(r >> 16))*TPDF_SCALE;
+}
+
+/* quantization kernels */
+static void
+_flat16_generic(int16_t *dst, const float *src, const uint32_t *noise,
+                size_t n)
+{
+   size_t i;
+
+   for (i=0; i<n; ++i)
+   {
+      float v = src[i]*32768.0f + _tpdf(noise[i]);
+
+      v = _MINMAX(v, -32768.0f, 32767.0f);
+      dst[i] = (int16_t)lrintf(v);
+   }
+}
+
+#if HAVE_X86_SIMD
+static __attribute__((target("sse2"))) void
+_flat16_sse2(int16_t *dst, const float *src, const uint32_t *noise, size_t n)
+{
+   const __m128 scale = _mm_set1_ps(32768.0f);
+   const __m128 tpdf = _mm_set1_ps(TPDF_SCALE);
+   const __m128 min = _mm_set1_ps(-32768.0f);
+   const __m128 max = _mm_set1_ps(32767.0f);
+   const __m128i mask = _mm_set1_epi32(0xFFFF);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      __m128i r0 = _mm_loadu_si128((const __m128i*)(noise+i));
+      __m128i r1 = _mm_loadu_si128((const __m128i*)(noise+i+4));
+      __m128 v0, v1;
+
+      r0 = _mm_sub_epi32(_mm_and_si128(r0, mask), _mm_srli_epi32(r0, 16));
+      r1 = _mm_sub_epi32(_mm_and_si128(r1, mask), _mm_srli_epi32(r1, 16));
+
+      v0 = _mm_mul_ps(_mm_loadu_ps(src+i), scale);
+      v1 = _mm_mul_ps(_mm_loadu_ps(src+i+4), scale);
+      v0 = _mm_add_ps(v0, _mm_mul_ps(_mm_cvtepi32_ps(r0), tpdf));
+      v1 = _mm_add_ps(v1, _mm_mul_ps(_mm_cvtepi32_ps(r1), tpdf));
+      v0 = _mm_min_ps(_mm_max_ps(v0, min), max);
+      v1 = _mm_min_ps(_mm_max_ps(v1, min), max);
+
+      _mm_storeu_si128((__m128i*)(dst+i),
+                       _mm_packs_epi32(_mm_cvtps_epi32(v0),
+                                       _mm_cvtps_epi32(v1)));
+   }
+   if (i < n) _flat16_generic(dst+i, src+i, noise+i, n-i);
+}
+
+static __attribute__((target("avx2"))) void
+_flat16_avx2(int16_t *dst, const float *src, const uint32_t *noise, size_t n)
+{
+   const __m256 scale = _mm256_set1_ps(32768.0f);
+   const __m256 tpdf = _mm256_set1_ps(TPDF_SCALE);
+   const __m256 min = _mm256_set1_ps(-32768.0f);
+   const __m256 max = _mm256_set1_ps(32767.0f);
+   const __m256i mask = _mm256_set1_epi32(0xFFFF);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      __m256i r = _mm256_loadu_si256((const __m256i*)(noise+i));
+      __m256i q;
+      __m256 v;
+
+      r = _mm256_sub_epi32(_mm256_and_si256(r, mask),
+                           _mm256_srli_epi32(r, 16));
+
+      v = _mm256_mul_ps(_mm256_loadu_ps(src+i), scale);
+      v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(r), tpdf));
+      v = _mm256_min_ps(_mm256_max_ps(v, min), max);
+      q = _mm256_cvtps_epi32(v);
+
+      _mm_storeu_si128((__m128i*)(dst+i),
+                       _mm_packs_epi32(_mm256_castsi256_si128(q),
+                                       _mm256_extracti128_si256(q, 1)));
+   }
+   if (i < n) _flat16_generic(dst+i, src+i, noise+i, n-i);
+}
+#elif HAVE_ARM_NEON && defined(__aarch64__)
+static void
+_flat16_neon(int16_t *dst, const float *src, const uint32_t *noise, size_t n)
+{
+   const float32x4_t min = vdupq_n_f32(-32768.0f);
+   const float32x4_t max = vdupq_n_f32(32767.0f);
+   const uint32x4_t mask = vdupq_n_u32(0xFFFF);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      uint32x4_t r0 = vld1q_u32(noise+i);
+      uint32x4_t r1 = vld1q_u32(noise+i+4);
+      int32x4_t d0, d1;
+      float32x4_t v0, v1;
+
+      d0 = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(r0, mask)),
+                     vreinterpretq_s32_u32(vshrq_n_u32(r0, 16)));
+      d1 = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(r1, mask)),
+                     vreinterpretq_s32_u32(vshrq_n_u32(r1, 16)));
+
+      v0 = vmulq_n_f32(vld1q_f32(src+i), 32768.0f);
+      v1 = vmulq_n_f32(vld1q_f32(src+i+4), 32768.0f);
+      v0 = vmlaq_n_f32(v0, vcvtq_f32_s32(d0), TPDF_SCALE);
+      v1 = vmlaq_n_f32(v1, vcvtq_f32_s32(d1), TPDF_SCALE);
+      v0 = vminq_f32(vmaxq_f32(v0, min), max);
+      v1 = vminq_f32(vmaxq_f32(v1, min), max);
+
+      vst1q_s16(dst+i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(v0)),
+                                    vqmovn_s32(vcvtnq_s32_f32(v1))));
+   }
+   if (i < n) _flat16_generic(dst+i, src+i, noise+i, n-i);
+}
+#endif
+
+/*
+ * Error feedback quantizer: the filtered quantization error of the
+ * previous samples of the same track is subtracted before quantization,
+ * so the noise transfer function becomes 1 - H(z).
+ */
+static void
+_shaped(_aaxDither *d, void *dst, const float *src, const uint32_t *noise,
+        size_t n)
+{
+   unsigned int tracks = d->tracks, order = d->order;
+   unsigned int t = d->track, k;
+   const float *h = d->coeffs;
+   size_t i;
+
+   for (i=0; i<n; ++i)
+   {
+      float *e = d->err + t*MAX_ORDER;
+      float v = src[i]*d->scale;
+      float y;
+
+      for (k=0; k<order; ++k) {
+         v -= h[k]*e[k];
+      }
+      y = (float)lrintf(v + _tpdf(noise[i]));
+
+      if (order)
+      {
+         for (k=order-1; k>0; --k) {
+            e[k] = e[k-1];
+         }
+         e[0] = y - v;
+      }
+
+      y = _MINMAX(y, d->min, d->max);
+      if (d->bits == 16) {
+         ((int16_t*)dst)[i] = (int16_t)y;
+      } else {
+         ((uint8_t*)dst)[i] = (uint8_t)((int)y + 128);
+      }
+      if (++t == tracks) t = 0;
+   }
+   d->track = t;
+}
+
+/**
+ * Create a ditherer.
+ *
+ * @param tracks the number of interleaved tracks
+ * @param bits the output resolution, 16 for signed or 8 for unsigned samples
+ * @param shape the noise shaping filter, AAX_DITHER_OFF is not supported
+ * @param seed the seed of the dither noise, the same seed gives the same
+ *        output for the same input
+ *
+ * Returns NULL on error.
+ */
+_aaxDither*
+_aaxDitherCreate(unsigned int tracks, unsigned int bits,
+                 enum _aaxDitherShape shape, uint64_t seed)
+{
+   _aaxDither *d;
+
+   if (!tracks || (bits != 8 && bits != 16) ||
+       shape == AAX_DITHER_OFF || shape >= AAX_DITHER_MAX) {
+      return NULL;
+   }
+
+   d = calloc(1, sizeof(_aaxDither));
+   if (!d) return d;
+
+   d->err = calloc((size_t)tracks*MAX_ORDER, sizeof(float));
+   if (!d->err)
+   {
+      free(d);
+      return NULL;
+   }
+
+   d->tracks = tracks;
+   d->bits = bits;
+   d->order = _shape[shape].order;
+   d->coeffs = _shape[shape].coeffs;
+   d->scale = (bits == 16) ? 32768.0f : 128.0f;
+   d->min = -d->scale;
+   d->max = d->scale - 1.0f;
+   _aax_random_stream_seed(&d->rng, seed);
+
+   d->flat16 = _flat16_generic;
+#if HAVE_X86_SIMD
+   if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_AVX2) d->flat16 = _flat16_avx2;
+   else if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_SSE2) d->flat16 = _flat16_sse2;
+#elif HAVE_ARM_NEON && defined(__aarch64__)
+   d->flat16 = _flat16_neon;
+#endif
+
+   return d;
+}
+
+void
+_aaxDitherDestroy(_aaxDither *d)
+{
+   if (d)
+   {
+      free(d->err);
+      free(d);
+   }
+}
+
+/**
+ * Quantize a block of interleaved audio.
+ *
+ * @param d the ditherer
+ * @param dst the interleaved 16-bit signed or 8-bit unsigned output samples
+ * @param src the interleaved input frames in the range of -1.0 to 1.0
+ * @param no_frames the number of frames
+ */
+void
+_aaxDitherProcess(_aaxDither *d, void *dst, const float *src,
+                  size_t no_frames)
+{
+   size_t num = no_frames*d->tracks;
+   unsigned int size = d->bits/8;
+   char *ptr = (char*)dst;
+   size_t pos = 0;
+
+   while (pos < num)
+   {
+      size_t len = _MIN(num-pos, NOISE_BLOCK);
+
+      _aax_random_stream_fill(&d->rng, d->noise, len);
+      if (!d->order && d->bits == 16) {
+         d->flat16((int16_t*)ptr, src+pos, d->noise, len);
+      } else {
+         _shaped(d, ptr, src+pos, d->noise, len);
+      }
+      ptr += len*size;
+      pos += len;
+   }
+}
+
+int
+_aaxDitherGetShape(const char *name)
+{
+   int i;
+
+   for (i=0; i<AAX_DITHER_MAX; ++i)
+   {
+      if (!strcasecmp(name, _shape[i].name)) return i;
+   }
+   return -1;
+}
@@ -0,0 +1,76 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_DITHER_H
+#define __AAX_DITHER_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+/*
+ * Quantization of interleaved 32-bit float audio to 16-bit signed or
+ * 8-bit unsigned integers using TPDF dither and optional noise shaping.
+ *
+ * The dither noise comes from vectorised xoshiro128+ streams which are
+ * owned by the ditherer, so every thread should use its own ditherer.
+ * The noise shaping filters feed back the quantization error of every
+ * track to move the noise to frequencies where the ear is less sensitive.
+ * The filters are designed for sample rates of 44.1kHz and 48kHz.
+ */
+enum _aaxDitherShape
+{
+   AAX_DITHER_OFF = 0,
+   AAX_DITHER_TPDF,		/* flat triangular dither */
+   AAX_DITHER_SHAPED,		/* first order high-pass noise shaping */
+   AAX_DITHER_LIPSHITZ,		/* 5-tap E-weighted noise shaping */
+   AAX_DITHER_WANNAMAKER,	/* 9-tap F-weighted noise shaping */
+
+   AAX_DITHER_MAX
+};
+
+typedef struct _aaxDither _aaxDither;
+
+_aaxDither* _aaxDitherCreate(unsigned int, unsigned int, enum _aaxDitherShape, uint64_t);
+void _aaxDitherDestroy(_aaxDither*);
+
+void _aaxDitherProcess(_aaxDither*, void*, const float*, size_t);
+
+/* the noise shape by name: off, tpdf, shaped, lipshitz or wannamaker, or -1 */
+int _aaxDitherGetShape(const char*);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_DITHER_H */
+
@@ -0,0 +1,625 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "interleave.h"
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#endif
+
+#define ALWAYS_INLINE		inline __attribute__((always_inline))
+
+/* Call fn with constant track and sample sizes for the common layouts */
+#define DISPATCH_BYTES(fn, d, s, t, b, n, i) \
+   switch (b) { \
+   case 1: fn(d, s, t, 1, n, i); break; \
+   case 2: fn(d, s, t, 2, n, i); break; \
+   case 3: fn(d, s, t, 3, n, i); break; \
+   case 4: fn(d, s, t, 4, n, i); break; \
+   default: fn(d, s, t, b, n, i); break; \
+   }
+
+#define DISPATCH(fn, d, s, t, b, n, i) \
+   switch (t) { \
+   case 2: DISPATCH_BYTES(fn, d, s, 2, b, n, i); break; \
+   case 4: DISPATCH_BYTES(fn, d, s, 4, b, n, i); break; \
+   case 6: DISPATCH_BYTES(fn, d, s, 6, b, n, i); break; \
+   case 8: DISPATCH_BYTES(fn, d, s, 8, b, n, i); break; \
+   default: DISPATCH_BYTES(fn, d, s, t, b, n, i); break; \
+   }
+
+/*
+ * Generic versions, starting at sample i. With constant tracks and bytes
+ * the compiler turns the memcpy calls into plain loads and stores.
+ */
+static ALWAYS_INLINE void
+_interleave_cpu(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                unsigned int bytes, size_t no_samples, size_t i)
+{
+   d += i*tracks*bytes;
+   for (; i<no_samples; ++i)
+   {
+      unsigned int t;
+      for (t=0; t<tracks; ++t)
+      {
+         memcpy(d, s + (t*no_samples + i)*bytes, bytes);
+         d += bytes;
+      }
+   }
+}
+
+static ALWAYS_INLINE void
+_deinterleave_cpu(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                  unsigned int bytes, size_t no_samples, size_t i)
+{
+   s += i*tracks*bytes;
+   for (; i<no_samples; ++i)
+   {
+      unsigned int t;
+      for (t=0; t<tracks; ++t)
+      {
+         memcpy(d + (t*no_samples + i)*bytes, s, bytes);
+         s += bytes;
+      }
+   }
+}
+
+#if HAVE_X86_SIMD
+/*
+ * Power of two track counts of 1, 2 and 4 byte samples are (de)interleaved
+ * one register of every track at a time. Interleaving is a perfect shuffle:
+ * every stage pairs register t with register t+tracks/2 using the unpack
+ * instructions. Deinterleaving reverses it by splitting pairs of registers
+ * into their even and odd samples.
+ *
+ * The AVX2 unpack and pack instructions work on two independent 128-bit
+ * lanes so the 128-bit halves are swapped into place before (or after)
+ * the lane-wise shuffle.
+ *
+ * The kernels return the number of samples per track they have processed,
+ * the remainder is left for the generic code.
+ */
+# if defined(__clang__)
+#  define UNROLL		_Pragma("unroll")
+# elif __GNUC__ >= 8
+#  define UNROLL		_Pragma("GCC unroll 8")
+# else
+#  define UNROLL
+# endif
+
+# define SIMD_TRACKS(t)	((t) == 2 || (t) == 4 || (t) == 8)
+
+/* SSE2 */
+static ALWAYS_INLINE __attribute__((target("sse2"))) __m128i
+_unpacklo_sse2(__m128i a, __m128i b, unsigned int bytes)
+{
+   if (bytes == 1) return _mm_unpacklo_epi8(a, b);
+   if (bytes == 2) return _mm_unpacklo_epi16(a, b);
+   return _mm_unpacklo_epi32(a, b);
+}
+
+static ALWAYS_INLINE __attribute__((target("sse2"))) __m128i
+_unpackhi_sse2(__m128i a, __m128i b, unsigned int bytes)
+{
+   if (bytes == 1) return _mm_unpackhi_epi8(a, b);
+   if (bytes == 2) return _mm_unpackhi_epi16(a, b);
+   return _mm_unpackhi_epi32(a, b);
+}
+
+static ALWAYS_INLINE __attribute__((target("sse2"))) __m128i
+_even_sse2(__m128i a, __m128i b, unsigned int bytes)
+{
+   if (bytes == 1)
+   {
+      const __m128i mask = _mm_set1_epi16(0xFF);
+      return _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+   }
+   if (bytes == 2)
+   {
+      a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+      b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+      return _mm_packs_epi32(a, b);
+   }
+   return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                          _mm_castsi128_ps(b),
+                                          _MM_SHUFFLE(2,0,2,0)));
+}
+
+static ALWAYS_INLINE __attribute__((target("sse2"))) __m128i
+_odd_sse2(__m128i a, __m128i b, unsigned int bytes)
+{
+   if (bytes == 1) {
+      return _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+   }
+   if (bytes == 2) {
+      return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+   }
+   return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                          _mm_castsi128_ps(b),
+                                          _MM_SHUFFLE(3,1,3,1)));
+}
+
+static ALWAYS_INLINE __attribute__((target("sse2"))) size_t
+_interleave_sse2_tb(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                    unsigned int bytes, size_t no_samples)
+{
+   const unsigned int step = sizeof(__m128i)/bytes;
+   const unsigned int half = tracks/2;
+   size_t i;
+
+   for (i=0; i+step <= no_samples; i += step)
+   {
+      __m128i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         v[t] = _mm_loadu_si128((const __m128i*)(s + (t*no_samples + i)*bytes));
+      }
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[2*t] = _unpacklo_sse2(v[t], v[t+half], bytes);
+            w[2*t+1] = _unpackhi_sse2(v[t], v[t+half], bytes);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm_storeu_si128((__m128i*)(d + i*tracks*bytes) + t, v[t]);
+      }
+   }
+   return i;
+}
+
+static ALWAYS_INLINE __attribute__((target("sse2"))) size_t
+_deinterleave_sse2_tb(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                      unsigned int bytes, size_t no_samples)
+{
+   const unsigned int step = sizeof(__m128i)/bytes;
+   const unsigned int half = tracks/2;
+   size_t i;
+
+   for (i=0; i+step <= no_samples; i += step)
+   {
+      __m128i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         v[t] = _mm_loadu_si128((const __m128i*)(s + i*tracks*bytes) + t);
+      }
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[t] = _even_sse2(v[2*t], v[2*t+1], bytes);
+            w[t+half] = _odd_sse2(v[2*t], v[2*t+1], bytes);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm_storeu_si128((__m128i*)(d + (t*no_samples + i)*bytes), v[t]);
+      }
+   }
+   return i;
+}
+
+/*
+ * SSSE3: 24-bit samples are expanded to 32-bit using a byte shuffle, four
+ * samples per track at a time, and packed again after the 32-bit shuffle.
+ * Every register is loaded and stored as 16 bytes while only 12 bytes are
+ * used, the extra bytes are overwritten by the next store. The loop stops
+ * early enough that no access goes beyond the end of the buffers.
+ */
+static ALWAYS_INLINE __attribute__((target("ssse3"))) size_t
+_interleave24_ssse3_t(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                      size_t no_samples)
+{
+   const unsigned int half = tracks/2;
+   const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                        6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+                                      10, 12, 13, 14, -1, -1, -1, -1);
+   size_t i;
+
+   for (i=0; i+6 <= no_samples; i += 4)
+   {
+      __m128i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t)
+      {
+         v[t] = _mm_loadu_si128((const __m128i*)(s + (t*no_samples + i)*3));
+         v[t] = _mm_shuffle_epi8(v[t], expand);
+      }
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[2*t] = _mm_unpacklo_epi32(v[t], v[t+half]);
+            w[2*t+1] = _mm_unpackhi_epi32(v[t], v[t+half]);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm_storeu_si128((__m128i*)(d + (i*tracks + 4*t)*3),
+                          _mm_shuffle_epi8(v[t], pack));
+      }
+   }
+   return i;
+}
+
+static ALWAYS_INLINE __attribute__((target("ssse3"))) size_t
+_deinterleave24_ssse3_t(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                        size_t no_samples)
+{
+   const unsigned int half = tracks/2;
+   const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                        6, 7, 8, -1, 9, 10, 11, -1);
+   const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+                                      10, 12, 13, 14, -1, -1, -1, -1);
+   size_t i;
+
+   for (i=0; i+6 <= no_samples; i += 4)
+   {
+      __m128i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t)
+      {
+         v[t] = _mm_loadu_si128((const __m128i*)(s + (i*tracks + 4*t)*3));
+         v[t] = _mm_shuffle_epi8(v[t], expand);
+      }
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[t] = _even_sse2(v[2*t], v[2*t+1], 4);
+            w[t+half] = _odd_sse2(v[2*t], v[2*t+1], 4);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm_storeu_si128((__m128i*)(d + (t*no_samples + i)*3),
+                          _mm_shuffle_epi8(v[t], pack));
+      }
+   }
+   return i;
+}
+
+static __attribute__((target("ssse3"))) size_t
+_interleave24_ssse3(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                    size_t no_samples)
+{
+   switch (tracks)
+   {
+   case 2: return _interleave24_ssse3_t(d, s, 2, no_samples);
+   case 4: return _interleave24_ssse3_t(d, s, 4, no_samples);
+   case 8: return _interleave24_ssse3_t(d, s, 8, no_samples);
+   default: return 0;
+   }
+}
+
+static __attribute__((target("ssse3"))) size_t
+_deinterleave24_ssse3(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                      size_t no_samples)
+{
+   switch (tracks)
+   {
+   case 2: return _deinterleave24_ssse3_t(d, s, 2, no_samples);
+   case 4: return _deinterleave24_ssse3_t(d, s, 4, no_samples);
+   case 8: return _deinterleave24_ssse3_t(d, s, 8, no_samples);
+   default: return 0;
+   }
+}
+
+/* AVX2 */
+static ALWAYS_INLINE __attribute__((target("avx2"))) __m256i
+_unpacklo_avx2(__m256i a, __m256i b, unsigned int bytes)
+{
+   if (bytes == 1) return _mm256_unpacklo_epi8(a, b);
+   if (bytes == 2) return _mm256_unpacklo_epi16(a, b);
+   return _mm256_unpacklo_epi32(a, b);
+}
+
+static ALWAYS_INLINE __attribute__((target("avx2"))) __m256i
+_unpackhi_avx2(__m256i a, __m256i b, unsigned int bytes)
+{
+   if (bytes == 1) return _mm256_unpackhi_epi8(a, b);
+   if (bytes == 2) return _mm256_unpackhi_epi16(a, b);
+   return _mm256_unpackhi_epi32(a, b);
+}
+
+static ALWAYS_INLINE __attribute__((target("avx2"))) __m256i
+_even_avx2(__m256i a, __m256i b, unsigned int bytes)
+{
+   if (bytes == 1)
+   {
+      const __m256i mask = _mm256_set1_epi16(0xFF);
+      return _mm256_packus_epi16(_mm256_and_si256(a, mask),
+                                 _mm256_and_si256(b, mask));
+   }
+   if (bytes == 2)
+   {
+      a = _mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16);
+      b = _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16);
+      return _mm256_packs_epi32(a, b);
+   }
+   return _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a),
+                                                _mm256_castsi256_ps(b),
+                                                _MM_SHUFFLE(2,0,2,0)));
+}
+
+static ALWAYS_INLINE __attribute__((target("avx2"))) __m256i
+_odd_avx2(__m256i a, __m256i b, unsigned int bytes)
+{
+   if (bytes == 1) {
+      return _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+                                 _mm256_srli_epi16(b, 8));
+   }
+   if (bytes == 2) {
+      return _mm256_packs_epi32(_mm256_srai_epi32(a, 16),
+                                _mm256_srai_epi32(b, 16));
+   }
+   return _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a),
+                                                _mm256_castsi256_ps(b),
+                                                _MM_SHUFFLE(3,1,3,1)));
+}
+
+static ALWAYS_INLINE __attribute__((target("avx2"))) size_t
+_interleave_avx2_tb(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                    unsigned int bytes, size_t no_samples)
+{
+   const unsigned int step = sizeof(__m256i)/bytes;
+   const unsigned int half = tracks/2;
+   size_t i;
+
+   for (i=0; i+step <= no_samples; i += step)
+   {
+      __m256i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         v[t] = _mm256_loadu_si256((const __m256i*)(s + (t*no_samples + i)*bytes));
+      }
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[2*t] = _unpacklo_avx2(v[t], v[t+half], bytes);
+            w[2*t+1] = _unpackhi_avx2(v[t], v[t+half], bytes);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+
+      /* low lanes hold the first half of the output, high lanes the rest */
+      UNROLL
+      for (t=0; t<half; ++t)
+      {
+         w[t] = _mm256_permute2x128_si256(v[2*t], v[2*t+1], 0x20);
+         w[t+half] = _mm256_permute2x128_si256(v[2*t], v[2*t+1], 0x31);
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm256_storeu_si256((__m256i*)(d + i*tracks*bytes) + t, w[t]);
+      }
+   }
+   return i;
+}
+
+static ALWAYS_INLINE __attribute__((target("avx2"))) size_t
+_deinterleave_avx2_tb(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                      unsigned int bytes, size_t no_samples)
+{
+   const unsigned int step = sizeof(__m256i)/bytes;
+   const unsigned int half = tracks/2;
+   size_t i;
+
+   for (i=0; i+step <= no_samples; i += step)
+   {
+      __m256i v[8], w[8];
+      unsigned int t, stage;
+
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         w[t] = _mm256_loadu_si256((const __m256i*)(s + i*tracks*bytes) + t);
+      }
+      UNROLL
+      for (t=0; t<half; ++t)
+      {
+         v[2*t] = _mm256_permute2x128_si256(w[t], w[t+half], 0x20);
+         v[2*t+1] = _mm256_permute2x128_si256(w[t], w[t+half], 0x31);
+      }
+
+      UNROLL
+      for (stage=tracks; stage > 1; stage /= 2)
+      {
+         UNROLL
+         for (t=0; t<half; ++t)
+         {
+            w[t] = _even_avx2(v[2*t], v[2*t+1], bytes);
+            w[t+half] = _odd_avx2(v[2*t], v[2*t+1], bytes);
+         }
+         UNROLL
+         for (t=0; t<tracks; ++t) v[t] = w[t];
+      }
+      UNROLL
+      for (t=0; t<tracks; ++t) {
+         _mm256_storeu_si256((__m256i*)(d + (t*no_samples + i)*bytes), v[t]);
+      }
+   }
+   return i;
+}
+
+# define SIMD_KERNEL(name) \
+static __attribute__((target(#name))) size_t \
+_interleave_##name(uint8_t *d, const uint8_t *s, unsigned int tracks, \
+                   unsigned int bytes, size_t no_samples) \
+{ \
+   size_t i = 0; \
+   DISPATCH_SIMD(_interleave_##name##_tb, d, s, tracks, bytes, no_samples, i); \
+   return i; \
+} \
+static __attribute__((target(#name))) size_t \
+_deinterleave_##name(uint8_t *d, const uint8_t *s, unsigned int tracks, \
+                     unsigned int bytes, size_t no_samples) \
+{ \
+   size_t i = 0; \
+   DISPATCH_SIMD(_deinterleave_##name##_tb, d, s, tracks, bytes, no_samples, i); \
+   return i; \
+}
+
+# define DISPATCH_SIMD_BYTES(fn, d, s, t, b, n, i) \
+   switch (b) { \
+   case 1: i = fn(d, s, t, 1, n); break; \
+   case 2: i = fn(d, s, t, 2, n); break; \
+   case 4: i = fn(d, s, t, 4, n); break; \
+   default: break; \
+   }
+
+# define DISPATCH_SIMD(fn, d, s, t, b, n, i) \
+   switch (t) { \
+   case 2: DISPATCH_SIMD_BYTES(fn, d, s, 2, b, n, i); break; \
+   case 4: DISPATCH_SIMD_BYTES(fn, d, s, 4, b, n, i); break; \
+   case 8: DISPATCH_SIMD_BYTES(fn, d, s, 8, b, n, i); break; \
+   default: break; \
+   }
+
+SIMD_KERNEL(sse2)
+SIMD_KERNEL(avx2)
+#endif /* HAVE_X86_SIMD */
+
+static void
+_interleave_generic(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                    unsigned int bytes, size_t no_samples, size_t i)
+{
+   DISPATCH(_interleave_cpu, d, s, tracks, bytes, no_samples, i);
+}
+
+static void
+_deinterleave_generic(uint8_t *d, const uint8_t *s, unsigned int tracks,
+                      unsigned int bytes, size_t no_samples, size_t i)
+{
+   DISPATCH(_deinterleave_cpu, d, s, tracks, bytes, no_samples, i);
+}
+
+void
+_aax_interleave(void *dst, const void *src, unsigned int tracks,
+                unsigned int bytes, size_t no_samples)
+{
+   size_t i = 0;
+
+   if (tracks == 1)
+   {
+      memcpy(dst, src, no_samples*bytes);
+      return;
+   }
+
+#if HAVE_X86_SIMD
+   if (SIMD_TRACKS(tracks))
+   {
+      enum _aaxSIMDLevel level = _aaxGetSIMDSupportLevel();
+
+      if (bytes == 3)
+      {
+         if (level >= AAX_SIMD_SSSE3) {
+            i = _interleave24_ssse3(dst, src, tracks, no_samples);
+         }
+      }
+      else if (level >= AAX_SIMD_AVX2) {
+         i = _interleave_avx2(dst, src, tracks, bytes, no_samples);
+      }
+      else if (level >= AAX_SIMD_SSE2) {
+         i = _interleave_sse2(dst, src, tracks, bytes, no_samples);
+      }
+   }
+#endif
+   _interleave_generic(dst, src, tracks, bytes, no_samples, i);
+}
+
+void
+_aax_deinterleave(void *dst, const void *src, unsigned int tracks,
+                  unsigned int bytes, size_t no_samples)
+{
+   size_t i = 0;
+
+   if (tracks == 1)
+   {
+      memcpy(dst, src, no_samples*bytes);
+      return;
+   }
+
+#if HAVE_X86_SIMD
+   if (SIMD_TRACKS(tracks))
+   {
+      enum _aaxSIMDLevel level = _aaxGetSIMDSupportLevel();
+
+      if (bytes == 3)
+      {
+         if (level >= AAX_SIMD_SSSE3) {
+            i = _deinterleave24_ssse3(dst, src, tracks, no_samples);
+         }
+      }
+      else if (level >= AAX_SIMD_AVX2) {
+         i = _deinterleave_avx2(dst, src, tracks, bytes, no_samples);
+      }
+      else if (level >= AAX_SIMD_SSE2) {
+         i = _deinterleave_sse2(dst, src, tracks, bytes, no_samples);
+      }
+   }
+#endif
+   _deinterleave_generic(dst, src, tracks, bytes, no_samples, i);
+}
+
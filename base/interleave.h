@@ -0,0 +1,62 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_INTERLEAVE_H
+#define __AAX_INTERLEAVE_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+/*
+ * Convert between non-interleaved audio data, where the samples of every
+ * track are stored one track after the other in a single buffer, and
+ * interleaved audio data where the samples of all tracks are stored frame
+ * by frame.
+ *
+ * bytes is the size of a single sample in bytes, no_samples the number of
+ * samples per track. The source and destination buffers may not overlap.
+ *
+ * 2, 4, 6 and 8 tracks of 1, 2, 3 and 4 byte samples (including 32-bit
+ * floats) use scalar kernels specialized for the layout. On top of that
+ * 2, 4 and 8 tracks use SSE2, SSSE3 (24-bit) or AVX2 kernels when the CPU
+ * supports it, 6 tracks stay on the scalar kernels.
+ */
+void _aax_interleave(void*, const void*, unsigned int, unsigned int, size_t);
+void _aax_deinterleave(void*, const void*, unsigned int, unsigned int, size_t);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_INTERLEAVE_H */
+
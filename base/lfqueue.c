@@ -0,0 +1,143 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "lfqueue.h"
+
+#define CACHE_LINE_SIZE		64
+
+#if defined(__GNUC__)
+# define LOAD_ACQUIRE(a)	__atomic_load_n(&(a), __ATOMIC_ACQUIRE)
+# define STORE_RELEASE(a, v)	__atomic_store_n(&(a), (v), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+# include <Windows.h>
+/* aligned 32-bit access is atomic, the barriers give the ordering */
+# define LOAD_ACQUIRE(a)	_load_acquire((volatile unsigned int*)&(a))
+# define STORE_RELEASE(a, v)	do { MemoryBarrier(); (a) = (v); } while(0)
+static inline unsigned int
+_load_acquire(volatile unsigned int *a) {
+   unsigned int rv = *a; MemoryBarrier(); return rv;
+}
+#else
+# error "Atomic load and store operations are not available for this compiler"
+#endif
+
+struct _aaxLFQueue
+{
+   /* written by the producer only */
+   unsigned int head;
+   unsigned int tail_cache;	/* the last seen consumer position */
+   char pad1[CACHE_LINE_SIZE - 2*sizeof(unsigned int)];
+
+   /* written by the consumer only */
+   unsigned int tail;
+   unsigned int head_cache;	/* the last seen producer position */
+   char pad2[CACHE_LINE_SIZE - 2*sizeof(unsigned int)];
+
+   unsigned int mask;
+   void **slots;
+};
+
+_aaxLFQueue*
+_aaxLFQueueCreate(unsigned int size)
+{
+   _aaxLFQueue *q = NULL;
+   unsigned int num = 2;
+
+   while (num < size && num < 0x80000000) num <<= 1;
+
+   q = calloc(1, sizeof(_aaxLFQueue));
+   if (q)
+   {
+      q->mask = num-1;
+      q->slots = calloc(num, sizeof(void*));
+      if (!q->slots)
+      {
+         free(q);
+         q = NULL;
+      }
+   }
+   return q;
+}
+
+void
+_aaxLFQueueDestroy(_aaxLFQueue *q)
+{
+   if (q)
+   {
+      free(q->slots);
+      free(q);
+   }
+}
+
+/*
+ * head and tail are free running counters, the queue is full when they are
+ * mask+1 entries apart. Each side only reloads the position of the other
+ * side when its cached copy says the queue is full or empty.
+ */
+int
+_aaxLFQueuePush(_aaxLFQueue *q, void *ptr)
+{
+   unsigned int head = q->head;
+   int rv = 1;
+
+   if (head - q->tail_cache > q->mask)
+   {
+      q->tail_cache = LOAD_ACQUIRE(q->tail);
+      if (head - q->tail_cache > q->mask) rv = 0;
+   }
+
+   if (rv)
+   {
+      q->slots[head & q->mask] = ptr;
+      STORE_RELEASE(q->head, head+1);
+   }
+   return rv;
+}
+
+void*
+_aaxLFQueuePop(_aaxLFQueue *q)
+{
+   unsigned int tail = q->tail;
+   void *rv = NULL;
+
+   if (tail == q->head_cache) {
+      q->head_cache = LOAD_ACQUIRE(q->head);
+   }
+
+   if (tail != q->head_cache)
+   {
+      rv = q->slots[tail & q->mask];
+      STORE_RELEASE(q->tail, tail+1);
+   }
+
+   return rv;
+}
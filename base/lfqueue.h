@@ -0,0 +1,66 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_LFQUEUE_H
+#define __AAX_LFQUEUE_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+/*
+ * Bounded single producer, single consumer queue of pointers which does not
+ * need any locking. One thread may push while another thread pops at the
+ * same time. The producer and consumer positions are kept on separate cache
+ * lines to prevent false sharing between the two threads.
+ */
+typedef struct _aaxLFQueue _aaxLFQueue;
+
+/*
+ * Create a queue which can hold at least size entries,
+ * the size is rounded up to the next power of two.
+ */
+_aaxLFQueue* _aaxLFQueueCreate(unsigned int);
+void _aaxLFQueueDestroy(_aaxLFQueue*);
+
+/* Returns 0 if the queue is full */
+int _aaxLFQueuePush(_aaxLFQueue*, void*);
+
+/* Returns NULL if the queue is empty */
+void* _aaxLFQueuePop(_aaxLFQueue*);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_LFQUEUE_H */
+
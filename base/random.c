@@ -34,8 +34,16 @@
 #endif
 #include <sys/time.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <base/types.h>
+#include <base/random.h>
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#elif HAVE_ARM_NEON
+# include <arm_neon.h>
+#endif
 
 static inline int
 _aax_hash3(unsigned int h1, unsigned int h2, unsigned int h3) {
@@ -155,3 +163,209 @@ _aax_rand()
     _aax_seed = x;
     return x * UINT64_C(0x2545F4914F6CDD1D);
 }
+
+
+/* vectorised xoshiro128+ streams */
+static uint64_t
+_splitmix64(uint64_t *x)
+{
+   uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+   z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+   z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+   return z ^ (z >> 31);
+}
+
+/* the same seed always results in the same streams */
+void
+_aax_random_stream_seed(_aax_random_stream_t *r, uint64_t seed)
+{
+   unsigned int l;
+
+   for (l=0; l<AAX_RANDOM_LANES; ++l)
+   {
+      uint64_t a = _splitmix64(&seed);
+      uint64_t b = _splitmix64(&seed);
+
+      r->s[0][l] = (uint32_t)a;
+      r->s[1][l] = (uint32_t)(a >> 32);
+      r->s[2][l] = (uint32_t)b;
+      r->s[3][l] = (uint32_t)(b >> 32) | 1; /* never all zero */
+   }
+}
+
+static void
+_stream_generic(_aax_random_stream_t *r, uint32_t *dst, size_t num)
+{
+   size_t i;
+
+   for (i=0; i<num; i += AAX_RANDOM_LANES)
+   {
+      unsigned int l;
+      for (l=0; l<AAX_RANDOM_LANES; ++l)
+      {
+         const uint32_t t = r->s[1][l] << 9;
+
+         dst[i+l] = r->s[0][l] + r->s[3][l];
+
+         r->s[2][l] ^= r->s[0][l];
+         r->s[3][l] ^= r->s[1][l];
+         r->s[1][l] ^= r->s[2][l];
+         r->s[0][l] ^= r->s[3][l];
+         r->s[2][l] ^= t;
+         r->s[3][l] = (r->s[3][l] << 11) | (r->s[3][l] >> 21);
+      }
+   }
+}
+
+#if HAVE_X86_SIMD
+static __attribute__((target("sse2"))) void
+_stream_sse2(_aax_random_stream_t *r, uint32_t *dst, size_t num)
+{
+   __m128i s0[2], s1[2], s2[2], s3[2];
+   unsigned int h;
+   size_t i;
+
+   for (h=0; h<2; ++h)
+   {
+      s0[h] = _mm_loadu_si128((__m128i*)&r->s[0][4*h]);
+      s1[h] = _mm_loadu_si128((__m128i*)&r->s[1][4*h]);
+      s2[h] = _mm_loadu_si128((__m128i*)&r->s[2][4*h]);
+      s3[h] = _mm_loadu_si128((__m128i*)&r->s[3][4*h]);
+   }
+
+   for (i=0; i<num; i += AAX_RANDOM_LANES)
+   {
+      for (h=0; h<2; ++h)
+      {
+         __m128i t = _mm_slli_epi32(s1[h], 9);
+
+         _mm_storeu_si128((__m128i*)(dst+i+4*h), _mm_add_epi32(s0[h], s3[h]));
+
+         s2[h] = _mm_xor_si128(s2[h], s0[h]);
+         s3[h] = _mm_xor_si128(s3[h], s1[h]);
+         s1[h] = _mm_xor_si128(s1[h], s2[h]);
+         s0[h] = _mm_xor_si128(s0[h], s3[h]);
+         s2[h] = _mm_xor_si128(s2[h], t);
+         s3[h] = _mm_or_si128(_mm_slli_epi32(s3[h], 11),
+                              _mm_srli_epi32(s3[h], 21));
+      }
+   }
+
+   for (h=0; h<2; ++h)
+   {
+      _mm_storeu_si128((__m128i*)&r->s[0][4*h], s0[h]);
+      _mm_storeu_si128((__m128i*)&r->s[1][4*h], s1[h]);
+      _mm_storeu_si128((__m128i*)&r->s[2][4*h], s2[h]);
+      _mm_storeu_si128((__m128i*)&r->s[3][4*h], s3[h]);
+   }
+}
+
+static __attribute__((target("avx2"))) void
+_stream_avx2(_aax_random_stream_t *r, uint32_t *dst, size_t num)
+{
+   __m256i s0 = _mm256_loadu_si256((__m256i*)r->s[0]);
+   __m256i s1 = _mm256_loadu_si256((__m256i*)r->s[1]);
+   __m256i s2 = _mm256_loadu_si256((__m256i*)r->s[2]);
+   __m256i s3 = _mm256_loadu_si256((__m256i*)r->s[3]);
+   size_t i;
+
+   for (i=0; i<num; i += AAX_RANDOM_LANES)
+   {
+      __m256i t = _mm256_slli_epi32(s1, 9);
+
+      _mm256_storeu_si256((__m256i*)(dst+i), _mm256_add_epi32(s0, s3));
+
+      s2 = _mm256_xor_si256(s2, s0);
+      s3 = _mm256_xor_si256(s3, s1);
+      s1 = _mm256_xor_si256(s1, s2);
+      s0 = _mm256_xor_si256(s0, s3);
+      s2 = _mm256_xor_si256(s2, t);
+      s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11),
+                           _mm256_srli_epi32(s3, 21));
+   }
+
+   _mm256_storeu_si256((__m256i*)r->s[0], s0);
+   _mm256_storeu_si256((__m256i*)r->s[1], s1);
+   _mm256_storeu_si256((__m256i*)r->s[2], s2);
+   _mm256_storeu_si256((__m256i*)r->s[3], s3);
+}
+#elif HAVE_ARM_NEON
+static void
+_stream_neon(_aax_random_stream_t *r, uint32_t *dst, size_t num)
+{
+   uint32x4_t s0[2], s1[2], s2[2], s3[2];
+   unsigned int h;
+   size_t i;
+
+   for (h=0; h<2; ++h)
+   {
+      s0[h] = vld1q_u32(&r->s[0][4*h]);
+      s1[h] = vld1q_u32(&r->s[1][4*h]);
+      s2[h] = vld1q_u32(&r->s[2][4*h]);
+      s3[h] = vld1q_u32(&r->s[3][4*h]);
+   }
+
+   for (i=0; i<num; i += AAX_RANDOM_LANES)
+   {
+      for (h=0; h<2; ++h)
+      {
+         uint32x4_t t = vshlq_n_u32(s1[h], 9);
+
+         vst1q_u32(dst+i+4*h, vaddq_u32(s0[h], s3[h]));
+
+         s2[h] = veorq_u32(s2[h], s0[h]);
+         s3[h] = veorq_u32(s3[h], s1[h]);
+         s1[h] = veorq_u32(s1[h], s2[h]);
+         s0[h] = veorq_u32(s0[h], s3[h]);
+         s2[h] = veorq_u32(s2[h], t);
+         s3[h] = vsriq_n_u32(vshlq_n_u32(s3[h], 11), s3[h], 21);
+      }
+   }
+
+   for (h=0; h<2; ++h)
+   {
+      vst1q_u32(&r->s[0][4*h], s0[h]);
+      vst1q_u32(&r->s[1][4*h], s1[h]);
+      vst1q_u32(&r->s[2][4*h], s2[h]);
+      vst1q_u32(&r->s[3][4*h], s3[h]);
+   }
+}
+#endif
+
+/**
+ * Fill a buffer with random numbers from the streams.
+ *
+ * @param r the stream state
+ * @param dst the buffer to fill
+ * @param num the number of 32-bit random numbers
+ */
+void
+_aax_random_stream_fill(_aax_random_stream_t *r, uint32_t *dst, size_t num)
+{
+   size_t len = num - num % AAX_RANDOM_LANES;
+
+   if (len)
+   {
+#if HAVE_X86_SIMD
+      if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_AVX2) {
+         _stream_avx2(r, dst, len);
+      } else if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_SSE2) {
+         _stream_sse2(r, dst, len);
+      } else {
+         _stream_generic(r, dst, len);
+      }
+#elif HAVE_ARM_NEON
+      _stream_neon(r, dst, len);
+#else
+      _stream_generic(r, dst, len);
+#endif
+   }
+
+   if (len < num)
+   {
+      uint32_t tmp[AAX_RANDOM_LANES];
+
+      _stream_generic(r, tmp, AAX_RANDOM_LANES);
+      memcpy(dst+len, tmp, (num-len)*sizeof(uint32_t));
+   }
+}
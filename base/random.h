@@ -41,6 +41,21 @@ float _aax_rand_sample();
 void _aax_srand(uint64_t);
 uint64_t _aax_rand();
 
+/*
+ * Independent xoshiro128+ streams, one for every lane of a SIMD vector.
+ * Every thread should use its own stream state. The generators are
+ * stored per state word so a vector holds the same word of every lane.
+ */
+#define AAX_RANDOM_LANES	8
+
+typedef struct
+{
+   uint32_t s[4][AAX_RANDOM_LANES];
+} _aax_random_stream_t;
+
+void _aax_random_stream_seed(_aax_random_stream_t*, uint64_t);
+void _aax_random_stream_fill(_aax_random_stream_t*, uint32_t*, size_t);
+
 #if defined(__cplusplus)
 }  /* extern "C" */
 #endif
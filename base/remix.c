@@ -0,0 +1,495 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "interleave.h"
+#include "remix.h"
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#elif HAVE_ARM_NEON
+# include <arm_neon.h>
+#endif
+
+/* the number of frames which are mixed at once by the planar mixer */
+#define REMIX_BLOCK		1024
+
+typedef void (*_mix_fn)(float*, const float*, float, size_t);
+typedef void (*_downmix_fn)(float*, const float*, float, float, size_t);
+
+struct _aaxRemix
+{
+   unsigned int in_tracks;
+   unsigned int out_tracks;
+   float *matrix;		/* out_tracks x in_tracks */
+   _mix_fn scale;		/* d = c*s */
+   _mix_fn mix;			/* d += c*s */
+   _downmix_fn stereo2mono;
+
+   float *in;			/* in_tracks x REMIX_BLOCK, planar */
+   float *out;			/* out_tracks x REMIX_BLOCK, planar */
+};
+
+/* mixing kernels */
+static void
+_scale_generic(float *d, const float *s, float c, size_t n)
+{
+   size_t i;
+   for (i=0; i<n; ++i) {
+      d[i] = c*s[i];
+   }
+}
+
+static void
+_mix_generic(float *d, const float *s, float c, size_t n)
+{
+   size_t i;
+   for (i=0; i<n; ++i) {
+      d[i] += c*s[i];
+   }
+}
+
+static void
+_stereo2mono_generic(float *d, const float *s, float c0, float c1, size_t n)
+{
+   size_t i;
+   for (i=0; i<n; ++i) {
+      d[i] = c0*s[2*i] + c1*s[2*i+1];
+   }
+}
+
+#if HAVE_X86_SIMD
+static __attribute__((target("sse2"))) void
+_scale_sse2(float *d, const float *s, float c, size_t n)
+{
+   const __m128 k = _mm_set1_ps(c);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      _mm_storeu_ps(d+i, _mm_mul_ps(_mm_loadu_ps(s+i), k));
+      _mm_storeu_ps(d+i+4, _mm_mul_ps(_mm_loadu_ps(s+i+4), k));
+   }
+   if (i < n) _scale_generic(d+i, s+i, c, n-i);
+}
+
+static __attribute__((target("sse2"))) void
+_mix_sse2(float *d, const float *s, float c, size_t n)
+{
+   const __m128 k = _mm_set1_ps(c);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      __m128 v0 = _mm_mul_ps(_mm_loadu_ps(s+i), k);
+      __m128 v1 = _mm_mul_ps(_mm_loadu_ps(s+i+4), k);
+
+      _mm_storeu_ps(d+i, _mm_add_ps(_mm_loadu_ps(d+i), v0));
+      _mm_storeu_ps(d+i+4, _mm_add_ps(_mm_loadu_ps(d+i+4), v1));
+   }
+   if (i < n) _mix_generic(d+i, s+i, c, n-i);
+}
+
+static __attribute__((target("sse2"))) void
+_stereo2mono_sse2(float *d, const float *s, float c0, float c1, size_t n)
+{
+   const __m128 k0 = _mm_set1_ps(c0);
+   const __m128 k1 = _mm_set1_ps(c1);
+   size_t i = 0;
+
+   for (; i+4 <= n; i += 4)
+   {
+      __m128 a = _mm_loadu_ps(s+2*i);
+      __m128 b = _mm_loadu_ps(s+2*i+4);
+      __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+      __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+
+      _mm_storeu_ps(d+i, _mm_add_ps(_mm_mul_ps(l, k0), _mm_mul_ps(r, k1)));
+   }
+   if (i < n) _stereo2mono_generic(d+i, s+2*i, c0, c1, n-i);
+}
+
+static __attribute__((target("avx2"))) void
+_scale_avx2(float *d, const float *s, float c, size_t n)
+{
+   const __m256 k = _mm256_set1_ps(c);
+   size_t i = 0;
+
+   for (; i+16 <= n; i += 16)
+   {
+      _mm256_storeu_ps(d+i, _mm256_mul_ps(_mm256_loadu_ps(s+i), k));
+      _mm256_storeu_ps(d+i+8, _mm256_mul_ps(_mm256_loadu_ps(s+i+8), k));
+   }
+   if (i < n) _scale_generic(d+i, s+i, c, n-i);
+}
+
+static __attribute__((target("avx2"))) void
+_mix_avx2(float *d, const float *s, float c, size_t n)
+{
+   const __m256 k = _mm256_set1_ps(c);
+   size_t i = 0;
+
+   for (; i+16 <= n; i += 16)
+   {
+      __m256 v0 = _mm256_mul_ps(_mm256_loadu_ps(s+i), k);
+      __m256 v1 = _mm256_mul_ps(_mm256_loadu_ps(s+i+8), k);
+
+      _mm256_storeu_ps(d+i, _mm256_add_ps(_mm256_loadu_ps(d+i), v0));
+      _mm256_storeu_ps(d+i+8, _mm256_add_ps(_mm256_loadu_ps(d+i+8), v1));
+   }
+   if (i < n) _mix_generic(d+i, s+i, c, n-i);
+}
+
+static __attribute__((target("avx2"))) void
+_stereo2mono_avx2(float *d, const float *s, float c0, float c1, size_t n)
+{
+   const __m256 k0 = _mm256_set1_ps(c0);
+   const __m256 k1 = _mm256_set1_ps(c1);
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      __m256 a = _mm256_loadu_ps(s+2*i);
+      __m256 b = _mm256_loadu_ps(s+2*i+8);
+      __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+      __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+      __m256 m = _mm256_add_ps(_mm256_mul_ps(l, k0), _mm256_mul_ps(r, k1));
+
+      /* the shuffles work per 128-bit lane: frames 0,1,4,5,2,3,6,7 */
+      m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m),
+                                                 _MM_SHUFFLE(3,1,2,0)));
+      _mm256_storeu_ps(d+i, m);
+   }
+   if (i < n) _stereo2mono_generic(d+i, s+2*i, c0, c1, n-i);
+}
+#elif HAVE_ARM_NEON
+static void
+_scale_neon(float *d, const float *s, float c, size_t n)
+{
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      vst1q_f32(d+i, vmulq_n_f32(vld1q_f32(s+i), c));
+      vst1q_f32(d+i+4, vmulq_n_f32(vld1q_f32(s+i+4), c));
+   }
+   if (i < n) _scale_generic(d+i, s+i, c, n-i);
+}
+
+static void
+_mix_neon(float *d, const float *s, float c, size_t n)
+{
+   size_t i = 0;
+
+   for (; i+8 <= n; i += 8)
+   {
+      vst1q_f32(d+i, vmlaq_n_f32(vld1q_f32(d+i), vld1q_f32(s+i), c));
+      vst1q_f32(d+i+4, vmlaq_n_f32(vld1q_f32(d+i+4), vld1q_f32(s+i+4), c));
+   }
+   if (i < n) _mix_generic(d+i, s+i, c, n-i);
+}
+
+static void
+_stereo2mono_neon(float *d, const float *s, float c0, float c1, size_t n)
+{
+   size_t i = 0;
+
+   for (; i+4 <= n; i += 4)
+   {
+      float32x4x2_t v = vld2q_f32(s+2*i);
+      vst1q_f32(d+i, vmlaq_n_f32(vmulq_n_f32(v.val[0], c0), v.val[1], c1));
+   }
+   if (i < n) _stereo2mono_generic(d+i, s+2*i, c0, c1, n-i);
+}
+#endif
+
+/*
+ * Mix a block of planar audio: every output track is built from the input
+ * tracks with a non-zero coefficient.
+ */
+static void
+_remix_planar(_aaxRemix *r, float *dst, const float *src, size_t n)
+{
+   unsigned int in_tracks = r->in_tracks;
+   unsigned int o, i;
+
+   for (o=0; o<r->out_tracks; ++o)
+   {
+      const float *m = r->matrix + o*in_tracks;
+      float *d = dst + o*n;
+      int first = 1;
+
+      for (i=0; i<in_tracks; ++i)
+      {
+         if (m[i] == 0.0f) continue;
+         if (first) r->scale(d, src + i*n, m[i], n);
+         else r->mix(d, src + i*n, m[i], n);
+         first = 0;
+      }
+      if (first) memset(d, 0, n*sizeof(float));
+   }
+}
+
+/**
+ * Create a remixer.
+ *
+ * @param in_tracks the number of interleaved input tracks
+ * @param out_tracks the number of interleaved output tracks
+ * @param matrix out_tracks rows of in_tracks coefficients, the matrix is
+ *        copied
+ *
+ * Returns NULL on error.
+ */
+_aaxRemix*
+_aaxRemixCreate(unsigned int in_tracks, unsigned int out_tracks,
+                const float *matrix)
+{
+   _aaxRemix *r;
+   size_t size;
+
+   if (!in_tracks || in_tracks > AAX_REMIX_MAX_TRACKS ||
+       !out_tracks || out_tracks > AAX_REMIX_MAX_TRACKS || !matrix) {
+      return NULL;
+   }
+
+   r = calloc(1, sizeof(_aaxRemix));
+   if (!r) return r;
+
+   size = (size_t)out_tracks*in_tracks;
+   r->matrix = malloc(size*sizeof(float));
+   r->in = malloc((size_t)in_tracks*REMIX_BLOCK*sizeof(float));
+   r->out = malloc((size_t)out_tracks*REMIX_BLOCK*sizeof(float));
+   if (!r->matrix || !r->in || !r->out)
+   {
+      _aaxRemixDestroy(r);
+      return NULL;
+   }
+   memcpy(r->matrix, matrix, size*sizeof(float));
+   r->in_tracks = in_tracks;
+   r->out_tracks = out_tracks;
+
+   r->scale = _scale_generic;
+   r->mix = _mix_generic;
+   r->stereo2mono = _stereo2mono_generic;
+#if HAVE_X86_SIMD
+   if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_AVX2)
+   {
+      r->scale = _scale_avx2;
+      r->mix = _mix_avx2;
+      r->stereo2mono = _stereo2mono_avx2;
+   }
+   else if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_SSE2)
+   {
+      r->scale = _scale_sse2;
+      r->mix = _mix_sse2;
+      r->stereo2mono = _stereo2mono_sse2;
+   }
+#elif HAVE_ARM_NEON
+   r->scale = _scale_neon;
+   r->mix = _mix_neon;
+   r->stereo2mono = _stereo2mono_neon;
+#endif
+
+   return r;
+}
+
+void
+_aaxRemixDestroy(_aaxRemix *r)
+{
+   if (r)
+   {
+      free(r->out);
+      free(r->in);
+      free(r->matrix);
+      free(r);
+   }
+}
+
+/**
+ * Remix a block of interleaved audio.
+ *
+ * @param r the remixer
+ * @param dst the interleaved output frames, out_tracks samples per frame
+ * @param src the interleaved input frames, in_tracks samples per frame
+ * @param no_frames the number of frames
+ *
+ * The source and destination buffers may not overlap.
+ */
+void
+_aaxRemixProcess(_aaxRemix *r, float *dst, const float *src,
+                 size_t no_frames)
+{
+   unsigned int in_tracks = r->in_tracks;
+   unsigned int out_tracks = r->out_tracks;
+   size_t pos = 0;
+
+   if (in_tracks == 2 && out_tracks == 1)
+   {
+      r->stereo2mono(dst, src, r->matrix[0], r->matrix[1], no_frames);
+      return;
+   }
+
+   /* single tracks are planar and interleaved at the same time */
+   while (pos < no_frames)
+   {
+      size_t n = _MIN(no_frames-pos, REMIX_BLOCK);
+      const float *in = src + pos*in_tracks;
+      float *out = dst + pos*out_tracks;
+
+      if (in_tracks > 1)
+      {
+         _aax_deinterleave(r->in, in, in_tracks, sizeof(float), n);
+         in = r->in;
+      }
+
+      if (out_tracks > 1)
+      {
+         _remix_planar(r, r->out, in, n);
+         _aax_interleave(out, r->out, out_tracks, sizeof(float), n);
+      }
+      else {
+         _remix_planar(r, out, in, n);
+      }
+      pos += n;
+   }
+}
+
+/*
+ * Downmix coefficients of the front, center, back and side tracks of the
+ * WAVE speaker layouts according to ITU-R BS.775, the LFE track is left out.
+ */
+#define DOWNMIX_LEVEL		0.7071f
+
+static int
+_stereo_preset(unsigned int tracks, float *m)
+{
+   static const char _layout[AAX_REMIX_MAX_TRACKS+1][AAX_REMIX_MAX_TRACKS]={
+      { 0 },
+      { 'c' },					/* mono */
+      { 'l', 'r' },				/* stereo */
+      { 0 },
+      { 'l', 'r', 'L', 'R' },			/* quad */
+      { 0 },
+      { 'l', 'r', 'c', 0, 'L', 'R' },		/* 5.1 */
+      { 0 },
+      { 'l', 'r', 'c', 0, 'L', 'R', 'L', 'R' }	/* 7.1 */
+   };
+   unsigned int o, i;
+
+   if (tracks > AAX_REMIX_MAX_TRACKS || !_layout[tracks][0]) return 0;
+
+   for (o=0; o<2; ++o)
+   {
+      float *row = m + o*tracks;
+      float sum = 0.0f;
+
+      for (i=0; i<tracks; ++i)
+      {
+         switch (_layout[tracks][i])
+         {
+         case 'l':
+            row[i] = o ? 0.0f : 1.0f;
+            break;
+         case 'r':
+            row[i] = o ? 1.0f : 0.0f;
+            break;
+         case 'L':
+            row[i] = o ? 0.0f : DOWNMIX_LEVEL;
+            break;
+         case 'R':
+            row[i] = o ? DOWNMIX_LEVEL : 0.0f;
+            break;
+         case 'c':
+            row[i] = (tracks == 1) ? 1.0f : DOWNMIX_LEVEL;
+            break;
+         default:
+            row[i] = 0.0f;
+            break;
+         }
+         sum += row[i];
+      }
+
+      /* a full scale signal in every track may not clip */
+      if (sum > 1.0f)
+      {
+         for (i=0; i<tracks; ++i) {
+            row[i] /= sum;
+         }
+      }
+   }
+   return 2;
+}
+
+/**
+ * Get the matrix of a remix preset.
+ *
+ * @param name the preset: mono or stereo
+ * @param in_tracks the number of input tracks
+ * @param matrix receives the coefficients, it should be able to hold
+ *        AAX_REMIX_MAX_TRACKS x AAX_REMIX_MAX_TRACKS coefficients
+ *
+ * Returns the number of output tracks or 0 if the preset is not supported
+ * for the number of input tracks.
+ */
+unsigned int
+_aaxRemixGetPreset(const char *name, unsigned int in_tracks, float *matrix)
+{
+   unsigned int rv = 0;
+
+   if (!in_tracks || in_tracks > AAX_REMIX_MAX_TRACKS) return rv;
+
+   if (!strcasecmp(name, "stereo")) {
+      rv = _stereo_preset(in_tracks, matrix);
+   }
+   else if (!strcasecmp(name, "mono"))
+   {
+      float stereo[2*AAX_REMIX_MAX_TRACKS];
+      unsigned int i;
+
+      /* the average of the stereo downmix or of all tracks */
+      if (_stereo_preset(in_tracks, stereo))
+      {
+         for (i=0; i<in_tracks; ++i) {
+            matrix[i] = 0.5f*(stereo[i] + stereo[in_tracks+i]);
+         }
+      }
+      else
+      {
+         for (i=0; i<in_tracks; ++i) {
+            matrix[i] = 1.0f/in_tracks;
+         }
+      }
+      rv = 1;
+   }
+   return rv;
+}
@@ -0,0 +1,66 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_REMIX_H
+#define __AAX_REMIX_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+/*
+ * Channel remixing of interleaved 32-bit float audio using a matrix of
+ * out_tracks rows by in_tracks columns: every output track is the sum of
+ * the input tracks multiplied by the coefficients of its row.
+ *
+ * Stereo to mono uses a dedicated kernel, other layouts are deinterleaved
+ * in blocks, mixed track by track and interleaved again. All kernels use
+ * SSE2, AVX2 or NEON when the CPU supports it.
+ */
+#define AAX_REMIX_MAX_TRACKS	8
+
+typedef struct _aaxRemix _aaxRemix;
+
+_aaxRemix* _aaxRemixCreate(unsigned int, unsigned int, const float*);
+void _aaxRemixDestroy(_aaxRemix*);
+
+void _aaxRemixProcess(_aaxRemix*, float*, const float*, size_t);
+
+/* the matrix of a preset by name: mono or stereo, returns the out tracks */
+unsigned int _aaxRemixGetPreset(const char*, unsigned int, float*);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_REMIX_H */
+
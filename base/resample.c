@@ -0,0 +1,491 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "resample.h"
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#elif HAVE_ARM_NEON
+# include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+# define M_PI			3.14159265358979323846
+#endif
+
+/* above this number of phases the nearest phase of the table is used */
+#define MAX_PHASES		1024
+/* the filter length is padded to a multiple of the widest SIMD vector */
+#define TAPS_ALIGN		8
+
+typedef float (*_dot_fn)(const float*, const float*, unsigned int);
+
+struct _aaxResample
+{
+   unsigned int tracks;
+   unsigned int up;		/* L: freq_out/gcd */
+   unsigned int down;		/* M: freq_in/gcd */
+   unsigned int phases;		/* number of filter phases in the table */
+   unsigned int taps;		/* filter length including padding */
+   unsigned int delay;		/* filter delay in input frames */
+   float *coeffs;		/* (phases+1) x taps */
+   _dot_fn dot;
+
+   float **hist;		/* per track input history */
+   size_t hist_len;		/* valid frames in the history */
+   size_t hist_max;
+   unsigned int phase;		/* position between two input frames in 1/L */
+
+   uint64_t in_total;
+   uint64_t out_total;
+
+   float *out;
+   size_t out_max;
+};
+
+static const struct {
+   const char *name;
+   unsigned int taps;		/* filter length at the lowest sample rate */
+   double beta;			/* Kaiser window shape: stop band attenuation */
+   double rolloff;		/* cutoff relative to the Nyquist frequency */
+} _quality[AAX_RESAMPLE_MAX] = {
+   { "fast",    16,  5.0, 0.85 },
+   { "medium",  32,  7.0, 0.90 },
+   { "high",    64,  9.0, 0.94 },
+   { "best",   128, 12.0, 0.96 }
+};
+
+/* filter kernels */
+static float
+_dot_generic(const float *a, const float *b, unsigned int n)
+{
+   float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+   unsigned int i;
+
+   for (i=0; i<n; i += 4)
+   {
+      s0 += a[i]*b[i];
+      s1 += a[i+1]*b[i+1];
+      s2 += a[i+2]*b[i+2];
+      s3 += a[i+3]*b[i+3];
+   }
+   return (s0 + s1) + (s2 + s3);
+}
+
+#if HAVE_X86_SIMD
+static __attribute__((target("sse2"))) float
+_dot_sse2(const float *a, const float *b, unsigned int n)
+{
+   __m128 s0 = _mm_setzero_ps();
+   __m128 s1 = _mm_setzero_ps();
+   unsigned int i;
+
+   for (i=0; i<n; i += 8)
+   {
+      s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+      s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a+i+4),
+                                     _mm_loadu_ps(b+i+4)));
+   }
+   s0 = _mm_add_ps(s0, s1);
+   s0 = _mm_add_ps(s0, _mm_movehl_ps(s0, s0));
+   s0 = _mm_add_ss(s0, _mm_shuffle_ps(s0, s0, 1));
+
+   return _mm_cvtss_f32(s0);
+}
+
+static __attribute__((target("avx2"))) float
+_dot_avx2(const float *a, const float *b, unsigned int n)
+{
+   __m256 s0 = _mm256_setzero_ps();
+   __m256 s1 = _mm256_setzero_ps();
+   unsigned int i = 0;
+   __m128 s;
+
+   for (; i+16 <= n; i += 16)
+   {
+      s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a+i),
+                                           _mm256_loadu_ps(b+i)));
+      s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a+i+8),
+                                           _mm256_loadu_ps(b+i+8)));
+   }
+   if (i < n) {
+      s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a+i),
+                                           _mm256_loadu_ps(b+i)));
+   }
+   s0 = _mm256_add_ps(s0, s1);
+   s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+   s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+   s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+
+   return _mm_cvtss_f32(s);
+}
+#elif HAVE_ARM_NEON
+static float
+_dot_neon(const float *a, const float *b, unsigned int n)
+{
+   float32x4_t s0 = vdupq_n_f32(0.0f);
+   float32x4_t s1 = vdupq_n_f32(0.0f);
+   float32x2_t s;
+   unsigned int i;
+
+   for (i=0; i<n; i += 8)
+   {
+      s0 = vmlaq_f32(s0, vld1q_f32(a+i), vld1q_f32(b+i));
+      s1 = vmlaq_f32(s1, vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+   }
+   s0 = vaddq_f32(s0, s1);
+   s = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+
+   return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+/* filter design */
+static unsigned int
+_gcd(unsigned int a, unsigned int b)
+{
+   while (b)
+   {
+      unsigned int t = a % b;
+      a = b;
+      b = t;
+   }
+   return a;
+}
+
+/* zeroth order modified Bessel function of the first kind */
+static double
+_bessel_i0(double x)
+{
+   double sum = 1.0, term = 1.0;
+   unsigned int k;
+
+   x = 0.25*x*x;
+   for (k=1; k<100 && term > 1e-12*sum; ++k)
+   {
+      term *= x/((double)k*k);
+      sum += term;
+   }
+   return sum;
+}
+
+/*
+ * Phase p of the filter gets the coefficients of the windowed sinc kernel
+ * at the offsets delay-k+p/phases for k in [0, length), so that the first
+ * coefficient applies to the oldest input frame. Every phase is normalized
+ * to unity gain at DC. The extra phase p == phases, one full input frame
+ * later, lets the nearest phase round up without moving to the next frame.
+ */
+static void
+_design_filter(_aaxResample *r, unsigned int length, double cutoff,
+               double beta)
+{
+   double i0_beta = _bessel_i0(beta);
+   double half = 0.5*length;
+   unsigned int p, k;
+
+   for (p=0; p<=r->phases; ++p)
+   {
+      float *h = r->coeffs + (size_t)p*r->taps;
+      double frac = (double)p/r->phases;
+      double sum = 0.0;
+
+      for (k=0; k<length; ++k)
+      {
+         double u = (double)r->delay - k + frac;
+         double x = u/half, v = 0.0;
+
+         if (fabs(x) < 1.0)
+         {
+            double t = M_PI*cutoff*u;
+
+            v = (fabs(t) > 1e-9) ? cutoff*sin(t)/t : cutoff;
+            v *= _bessel_i0(beta*sqrt(1.0 - x*x))/i0_beta;
+         }
+         h[k] = v;
+         sum += v;
+      }
+      for (k=0; k<length; ++k) {
+         h[k] = (float)(h[k]/sum);
+      }
+      for (; k<r->taps; ++k) {
+         h[k] = 0.0f;
+      }
+   }
+}
+
+/**
+ * Create a resampler.
+ *
+ * @param tracks the number of interleaved tracks
+ * @param freq_in the input sample rate in Hz
+ * @param freq_out the output sample rate in Hz
+ * @param quality the quality preset, higher quality uses longer filters
+ *
+ * Returns NULL on error.
+ */
+_aaxResample*
+_aaxResampleCreate(unsigned int tracks, unsigned int freq_in,
+                   unsigned int freq_out, enum _aaxResampleQuality quality)
+{
+   _aaxResample *r;
+   unsigned int i, g, length;
+   double ratio;
+
+   if (!tracks || !freq_in || !freq_out || quality >= AAX_RESAMPLE_MAX) {
+      return NULL;
+   }
+
+   r = calloc(1, sizeof(_aaxResample));
+   if (!r) return r;
+
+   g = _gcd(freq_in, freq_out);
+   r->tracks = tracks;
+   r->up = freq_out/g;
+   r->down = freq_in/g;
+   r->phases = _MIN(r->up, MAX_PHASES);
+
+   /* when downsampling the filter gets longer to keep the transition band */
+   ratio = _MIN(1.0, (double)r->up/r->down);
+   length = 2*(unsigned int)ceil(0.5*_quality[quality].taps/ratio);
+   r->delay = length/2 - 1;
+   r->taps = (length + TAPS_ALIGN-1) & ~(TAPS_ALIGN-1);
+
+   r->coeffs = malloc((size_t)(r->phases+1)*r->taps*sizeof(float));
+   r->hist = calloc(tracks, sizeof(float*));
+   if (!r->coeffs || !r->hist)
+   {
+      _aaxResampleDestroy(r);
+      return NULL;
+   }
+   _design_filter(r, length, ratio*_quality[quality].rolloff,
+                  _quality[quality].beta);
+
+   r->dot = _dot_generic;
+#if HAVE_X86_SIMD
+   if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_AVX2) r->dot = _dot_avx2;
+   else if (_aaxGetSIMDSupportLevel() >= AAX_SIMD_SSE2) r->dot = _dot_sse2;
+#elif HAVE_ARM_NEON
+   r->dot = _dot_neon;
+#endif
+
+   /* the history starts with delay frames of silence */
+   r->hist_max = r->taps + 4096;
+   for (i=0; i<tracks; ++i)
+   {
+      r->hist[i] = calloc(r->hist_max, sizeof(float));
+      if (!r->hist[i])
+      {
+         _aaxResampleDestroy(r);
+         return NULL;
+      }
+   }
+   r->hist_len = r->delay;
+
+   return r;
+}
+
+void
+_aaxResampleDestroy(_aaxResample *r)
+{
+   if (r)
+   {
+      unsigned int i;
+
+      if (r->hist)
+      {
+         for (i=0; i<r->tracks; ++i) {
+            free(r->hist[i]);
+         }
+         free(r->hist);
+      }
+      free(r->coeffs);
+      free(r->out);
+      free(r);
+   }
+}
+
+static int
+_reserve(_aaxResample *r, size_t hist_frames, size_t out_frames)
+{
+   unsigned int i;
+
+   if (hist_frames > r->hist_max)
+   {
+      for (i=0; i<r->tracks; ++i)
+      {
+         float *hist = realloc(r->hist[i], hist_frames*sizeof(float));
+         if (!hist) return 0;
+         r->hist[i] = hist;
+      }
+      r->hist_max = hist_frames;
+   }
+
+   if (out_frames > r->out_max)
+   {
+      float *out = realloc(r->out, out_frames*r->tracks*sizeof(float));
+      if (!out) return 0;
+      r->out = out;
+      r->out_max = out_frames;
+   }
+   return 1;
+}
+
+/*
+ * Calculate all output frames for which the input history is complete,
+ * but no more than max frames. The frames which are not needed anymore are
+ * removed from the history.
+ */
+static size_t
+_resample(_aaxResample *r, uint64_t max)
+{
+   unsigned int tracks = r->tracks;
+   unsigned int up = r->up, down = r->down;
+   unsigned int taps = r->taps;
+   unsigned int phase = r->phase;
+   float *dst = r->out;
+   size_t pos = 0, num = 0;
+   unsigned int t;
+
+   while (pos + taps <= r->hist_len && num < max)
+   {
+      unsigned int p = phase;
+      const float *h;
+
+      if (r->phases != up) {
+         p = (unsigned int)(((uint64_t)phase*r->phases + up/2)/up);
+      }
+      h = r->coeffs + (size_t)p*taps;
+
+      for (t=0; t<tracks; ++t) {
+         *dst++ = r->dot(h, r->hist[t]+pos, taps);
+      }
+      num++;
+
+      phase += down;
+      pos += phase/up;
+      phase %= up;
+   }
+   r->phase = phase;
+   r->out_total += num;
+
+   pos = _MIN(pos, r->hist_len);
+   if (pos)
+   {
+      r->hist_len -= pos;
+      for (t=0; t<tracks; ++t) {
+         memmove(r->hist[t], r->hist[t]+pos, r->hist_len*sizeof(float));
+      }
+   }
+   return num;
+}
+
+/**
+ * Resample a block of interleaved audio.
+ *
+ * @param r the resampler
+ * @param src the interleaved input frames
+ * @param no_frames the number of input frames
+ * @param dst the returned interleaved output frames
+ *
+ * Returns the number of output frames.
+ */
+size_t
+_aaxResampleProcess(_aaxResample *r, const float *src, size_t no_frames,
+                    float **dst)
+{
+   unsigned int tracks = r->tracks;
+   size_t i, max_out;
+   unsigned int t;
+
+   max_out = (size_t)((r->hist_len + no_frames)*(uint64_t)r->up/r->down) + 1;
+   if (!_reserve(r, r->hist_len + no_frames, max_out))
+   {
+      *dst = NULL;
+      return 0;
+   }
+
+   for (t=0; t<tracks; ++t)
+   {
+      const float *sptr = src + t;
+      float *hptr = r->hist[t] + r->hist_len;
+
+      for (i=0; i<no_frames; ++i)
+      {
+         *hptr++ = *sptr;
+         sptr += tracks;
+      }
+   }
+   r->hist_len += no_frames;
+   r->in_total += no_frames;
+
+   *dst = r->out;
+   return _resample(r, UINT64_MAX);
+}
+
+size_t
+_aaxResampleFlush(_aaxResample *r, float **dst)
+{
+   uint64_t total = (r->in_total*r->up + r->down-1)/r->down;
+   uint64_t remain = (total > r->out_total) ? total - r->out_total : 0;
+   size_t pad = r->taps - r->delay;
+   unsigned int t;
+
+   if (!_reserve(r, r->hist_len + pad, (size_t)remain + 1))
+   {
+      *dst = NULL;
+      return 0;
+   }
+
+   for (t=0; t<r->tracks; ++t) {
+      memset(r->hist[t] + r->hist_len, 0, pad*sizeof(float));
+   }
+   r->hist_len += pad;
+
+   *dst = r->out;
+   return _resample(r, remain);
+}
+
+int
+_aaxResampleGetQuality(const char *name)
+{
+   int i;
+
+   for (i=0; i<AAX_RESAMPLE_MAX; ++i)
+   {
+      if (!strcasecmp(name, _quality[i].name)) return i;
+   }
+   return -1;
+}
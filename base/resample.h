@@ -0,0 +1,78 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_RESAMPLE_H
+#define __AAX_RESAMPLE_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+/*
+ * Streaming sample rate conversion of interleaved 32-bit float audio using
+ * a polyphase windowed-sinc (Kaiser) filter bank. The coefficient table is
+ * calculated once when the resampler is created, the filter is applied
+ * using AVX2, SSE2 or NEON when available.
+ *
+ * Every call to _aaxResampleProcess returns as many output frames as can be
+ * calculated from the input so far, _aaxResampleFlush returns the remaining
+ * frames at the end of the stream. The total number of output frames is
+ * the number of input frames times freq_out/freq_in, rounded up. The
+ * returned data stays valid until the next call.
+ */
+enum _aaxResampleQuality
+{
+   AAX_RESAMPLE_FAST = 0,
+   AAX_RESAMPLE_MEDIUM,
+   AAX_RESAMPLE_HIGH,
+   AAX_RESAMPLE_BEST,
+
+   AAX_RESAMPLE_MAX
+};
+
+typedef struct _aaxResample _aaxResample;
+
+_aaxResample* _aaxResampleCreate(unsigned int, unsigned int, unsigned int, enum _aaxResampleQuality);
+void _aaxResampleDestroy(_aaxResample*);
+
+size_t _aaxResampleProcess(_aaxResample*, const float*, size_t, float**);
+size_t _aaxResampleFlush(_aaxResample*, float**);
+
+/* the quality preset by name: fast, medium, high or best, or -1 */
+int _aaxResampleGetQuality(const char*);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_RESAMPLE_H */
+
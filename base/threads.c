@@ -0,0 +1,307 @@
+/*
+ * Written by Erik Hofman.
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "threads.h"
+
+
+unsigned int
+_aaxGetNoCores()
+{
+   unsigned int rv = 1;
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+
+   GetSystemInfo(&info);
+   rv = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long cores = sysconf(_SC_NPROCESSORS_ONLN);
+   if (cores > 0) rv = cores;
+#endif
+   return rv;
+}
+
+#if HAVE_PTHREAD_H
+
+int
+_aaxThreadCreate(_aaxThread *t, _aaxThreadFn fn, void *arg) {
+   return (pthread_create(t, NULL, fn, arg) == 0) ? 0 : -1;
+}
+
+int
+_aaxThreadJoin(_aaxThread t) {
+   return (pthread_join(t, NULL) == 0) ? 0 : -1;
+}
+
+int
+_aaxMutexInit(_aaxMutex *m) {
+   return pthread_mutex_init(m, NULL);
+}
+
+int
+_aaxMutexDestroy(_aaxMutex *m) {
+   return pthread_mutex_destroy(m);
+}
+
+int
+_aaxMutexLock(_aaxMutex *m) {
+   return pthread_mutex_lock(m);
+}
+
+int
+_aaxMutexUnLock(_aaxMutex *m) {
+   return pthread_mutex_unlock(m);
+}
+
+int
+_aaxConditionInit(_aaxCondition *c) {
+   return pthread_cond_init(c, NULL);
+}
+
+int
+_aaxConditionDestroy(_aaxCondition *c) {
+   return pthread_cond_destroy(c);
+}
+
+int
+_aaxConditionWait(_aaxCondition *c, _aaxMutex *m) {
+   return pthread_cond_wait(c, m);
+}
+
+/* wakes up all waiting threads */
+int
+_aaxConditionSignal(_aaxCondition *c) {
+   return pthread_cond_broadcast(c);
+}
+
+#elif defined(_WIN32)
+
+typedef struct {
+   _aaxThreadFn fn;
+   void *arg;
+} _aaxThreadStart;
+
+static DWORD WINAPI
+_aaxThreadProc(LPVOID p)
+{
+   _aaxThreadStart s = *(_aaxThreadStart*)p;
+   free(p);
+   s.fn(s.arg);
+   return 0;
+}
+
+int
+_aaxThreadCreate(_aaxThread *t, _aaxThreadFn fn, void *arg)
+{
+   _aaxThreadStart *s = malloc(sizeof(_aaxThreadStart));
+   int rv = -1;
+
+   if (s)
+   {
+      s->fn = fn;
+      s->arg = arg;
+      *t = CreateThread(NULL, 0, _aaxThreadProc, s, 0, NULL);
+      if (*t) rv = 0;
+      else free(s);
+   }
+   return rv;
+}
+
+int
+_aaxThreadJoin(_aaxThread t)
+{
+   DWORD res = WaitForSingleObject(t, INFINITE);
+   CloseHandle(t);
+   return (res == WAIT_OBJECT_0) ? 0 : -1;
+}
+
+int
+_aaxMutexInit(_aaxMutex *m) {
+   InitializeCriticalSection(m);
+   return 0;
+}
+
+int
+_aaxMutexDestroy(_aaxMutex *m) {
+   DeleteCriticalSection(m);
+   return 0;
+}
+
+int
+_aaxMutexLock(_aaxMutex *m) {
+   EnterCriticalSection(m);
+   return 0;
+}
+
+int
+_aaxMutexUnLock(_aaxMutex *m) {
+   LeaveCriticalSection(m);
+   return 0;
+}
+
+int
+_aaxConditionInit(_aaxCondition *c) {
+   InitializeConditionVariable(c);
+   return 0;
+}
+
+int
+_aaxConditionDestroy(_aaxCondition *c) {
+   return 0;
+}
+
+int
+_aaxConditionWait(_aaxCondition *c, _aaxMutex *m) {
+   return SleepConditionVariableCS(c, m, INFINITE) ? 0 : -1;
+}
+
+int
+_aaxConditionSignal(_aaxCondition *c) {
+   WakeAllConditionVariable(c);
+   return 0;
+}
+
+#else /* NO_THREADS */
+
+int
+_aaxThreadCreate(_aaxThread *t, _aaxThreadFn fn, void *arg) {
+   return -1;
+}
+
+int
+_aaxThreadJoin(_aaxThread t) {
+   return -1;
+}
+
+int _aaxMutexInit(_aaxMutex *m) { return 0; }
+int _aaxMutexDestroy(_aaxMutex *m) { return 0; }
+int _aaxMutexLock(_aaxMutex *m) { return 0; }
+int _aaxMutexUnLock(_aaxMutex *m) { return 0; }
+
+int _aaxConditionInit(_aaxCondition *c) { return 0; }
+int _aaxConditionDestroy(_aaxCondition *c) { return 0; }
+int _aaxConditionWait(_aaxCondition *c, _aaxMutex *m) { return 0; }
+int _aaxConditionSignal(_aaxCondition *c) { return 0; }
+
+#endif
+
+
+typedef struct
+{
+   _aaxJobFn fn;
+   void *user;
+   _aaxMutex mutex;
+   unsigned int next;
+   unsigned int num_jobs;
+} _aaxJobQueue;
+
+typedef struct
+{
+   _aaxJobQueue *q;
+   unsigned int id;
+} _aaxWorker;
+
+static void*
+_aaxParallelWorker(void *arg)
+{
+   _aaxWorker *w = (_aaxWorker*)arg;
+   _aaxJobQueue *q = w->q;
+
+   do
+   {
+      unsigned int n;
+
+      _aaxMutexLock(&q->mutex);
+      n = q->next++;
+      _aaxMutexUnLock(&q->mutex);
+
+      if (n >= q->num_jobs) break;
+      q->fn(q->user, n, w->id);
+   }
+   while (1);
+
+   return NULL;
+}
+
+int
+_aaxParallelFor(unsigned int num_threads, unsigned int num_jobs,
+                _aaxJobFn fn, void *user)
+{
+   _aaxThread *threads = NULL;
+   _aaxWorker *workers = NULL, self;
+   unsigned int i, started = 0;
+   _aaxJobQueue q;
+
+   if (!num_threads) num_threads = _aaxGetNoCores();
+   if (num_threads > num_jobs) num_threads = num_jobs;
+   if (!num_threads) num_threads = 1;
+
+   q.fn = fn;
+   q.user = user;
+   q.next = 0;
+   q.num_jobs = num_jobs;
+   _aaxMutexInit(&q.mutex);
+
+   /* the calling thread is one of the workers */
+   self.q = &q;
+   self.id = 0;
+   if (num_threads > 1)
+   {
+      threads = malloc((num_threads-1)*sizeof(_aaxThread));
+      workers = malloc((num_threads-1)*sizeof(_aaxWorker));
+   }
+   if (threads && workers)
+   {
+      for (i=0; i<num_threads-1; ++i)
+      {
+         workers[started].q = &q;
+         workers[started].id = started+1;
+         if (_aaxThreadCreate(&threads[started], _aaxParallelWorker,
+                              &workers[started]) == 0)
+         {
+            started++;
+         }
+      }
+   }
+   _aaxParallelWorker(&self);
+
+   for (i=0; i<started; ++i) {
+      _aaxThreadJoin(threads[i]);
+   }
+   free(threads);
+   free(workers);
+   _aaxMutexDestroy(&q.mutex);
+
+   return started+1;
+}
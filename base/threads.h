@@ -0,0 +1,96 @@
+/*
+ * Written by Erik Hofman
+ *
+ * Public Domain (www.unlicense.org)
+ *
+ * This is free and unencumbered software released into the public domain.
+
+ * Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+ * this software, either in source code form or as a compiled binary, for any
+ * purpose, commercial or non-commercial, and by any means.
+ * 
+ * In jurisdictions that recognize copyright laws, the author or authors of this
+ * software dedicate any and all copyright interest in the software to the
+ * public domain. We make this dedication for the benefit of the public at
+ * large and to the detriment of our heirs and successors. We intend this
+ * dedication to be an overt act of relinquishment in perpetuity of all present
+ * and future rights to this software under copyright law.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __AAX_THREADS_H
+#define __AAX_THREADS_H 1
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include "types.h"
+
+#if HAVE_PTHREAD_H
+# include <pthread.h>
+
+typedef pthread_t		_aaxThread;
+typedef pthread_mutex_t		_aaxMutex;
+typedef pthread_cond_t		_aaxCondition;
+
+#elif defined(_WIN32)
+# include <Windows.h>
+
+typedef HANDLE			_aaxThread;
+typedef CRITICAL_SECTION	_aaxMutex;
+typedef CONDITION_VARIABLE	_aaxCondition;
+
+#else
+# define NO_THREADS		1
+
+typedef int			_aaxThread;
+typedef int			_aaxMutex;
+typedef int			_aaxCondition;
+#endif
+
+typedef void* (*_aaxThreadFn)(void*);
+typedef void (*_aaxJobFn)(void*, unsigned int, unsigned int);
+
+unsigned int _aaxGetNoCores();
+
+int _aaxThreadCreate(_aaxThread*, _aaxThreadFn, void*);
+int _aaxThreadJoin(_aaxThread);
+
+int _aaxMutexInit(_aaxMutex*);
+int _aaxMutexDestroy(_aaxMutex*);
+int _aaxMutexLock(_aaxMutex*);
+int _aaxMutexUnLock(_aaxMutex*);
+
+int _aaxConditionInit(_aaxCondition*);
+int _aaxConditionDestroy(_aaxCondition*);
+int _aaxConditionWait(_aaxCondition*, _aaxMutex*);
+int _aaxConditionSignal(_aaxCondition*);
+
+/*
+ * Call fn(user, n, worker) for every n in [0, num_jobs) spread across
+ * num_threads worker threads. Jobs are handed out one at a time so the
+ * workload stays balanced when jobs differ in size. A num_threads value of
+ * zero uses one thread per available CPU core. worker is the index of the
+ * calling thread, below num_threads (or the number of cores), which allows
+ * per thread state to be kept in an array. Returns the number of threads
+ * used after all jobs have finished.
+ */
+int _aaxParallelFor(unsigned int, unsigned int, _aaxJobFn, void*);
+
+#if defined(__cplusplus)
+}  /* extern "C" */
+#endif
+
+#endif /* !__AAX_THREADS_H */
+
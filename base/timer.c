@@ -148,7 +148,7 @@ int msecSleep(unsigned int dt_ms)
 
 int usecSleep(unsigned int dt_us)
 {
-    static struct timespec s;
+    struct timespec s;
     if (dt_us > 0)
     {
         s.tv_sec = (dt_us/1000000);
@@ -211,3 +211,19 @@ int _aaxTimerWait(_aaxTimer* time)
     return rv;
 }
 
+int _aaxTimerStart(_aaxTimer* timer)
+{
+    assert(timer);
+    return gettimeofday(&timer->start, NULL);
+}
+
+/* returns the elapsed time in seconds since _aaxTimerStart */
+double _aaxTimerElapsed(_aaxTimer* timer)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (double)(now.tv_sec - timer->start.tv_sec) +
+           1e-6*(double)(now.tv_usec - timer->start.tv_usec);
+}
+
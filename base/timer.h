@@ -94,6 +94,8 @@ void _aaxTimerDestroy(_aaxTimer*);
 int _aaxTimerStartRepeatable(_aaxTimer*, unsigned int);
 int _aaxTimerStop(_aaxTimer*);
 int _aaxTimerWait(_aaxTimer*);
+int _aaxTimerStart(_aaxTimer*);
+double _aaxTimerElapsed(_aaxTimer*);
 
 /* end of highres timing code */
 
@@ -24,10 +24,17 @@
 
 #include <strings.h>
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 
 #include "types.h"
 
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+/* ia32intrin.h defines _bswap64 as a macro for its own intrinsic */
+# undef _bswap64
+#endif
+
 #if 0
 uint32_t _mem_size(void *p)
 {
@@ -74,6 +81,201 @@ uint64_t _bswap64(uint64_t x)
    return x;
 }
 
+/*
+ * Bulk byte swapping of arrays of 16, 24, 32 and 64-bit values.
+ * The source and destination may be the same for in place conversion,
+ * other than that they may not overlap. Neither needs to be aligned.
+ */
+#if defined(__GNUC__)
+# define BSWAP16(x)	__builtin_bswap16(x)
+# define BSWAP32(x)	__builtin_bswap32(x)
+# define BSWAP64(x)	__builtin_bswap64(x)
+#else
+# define BSWAP16(x)	_bswap16(x)
+# define BSWAP32(x)	_bswap32(x)
+# define BSWAP64(x)	_bswap64(x)
+#endif
+
+#if HAVE_X86_SIMD
+/*
+ * Swap the bytes of every element using a byte shuffle.
+ * Returns the number of bytes which have been processed.
+ */
+static __attribute__((target("ssse3"))) size_t
+_bswap_ssse3(uint8_t *d, const uint8_t *s, size_t size, __m128i mask)
+{
+   size_t i;
+
+   for (i=0; i+sizeof(__m128i) <= size; i += sizeof(__m128i))
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+      _mm_storeu_si128((__m128i*)(d+i), _mm_shuffle_epi8(v, mask));
+   }
+   return i;
+}
+
+/*
+ * 24-bit values cross register boundaries so 16 of them (48 bytes) are
+ * swapped at a time. Every output register is assembled from the bytes of
+ * at most three input registers, a mask index of -1 selects a zero byte.
+ */
+static __attribute__((target("ssse3"))) size_t
+_bswap24_ssse3(uint8_t *d, const uint8_t *s, size_t size)
+{
+   const __m128i m00 = _mm_setr_epi8(2,1,0,5,4,3,8,7,6,11,10,9,14,13,12,-1);
+   const __m128i m01 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,
+                                     -1,-1,-1,-1,-1,-1,-1,1);
+   const __m128i m10 = _mm_setr_epi8(-1,15,-1,-1,-1,-1,-1,-1,
+                                     -1,-1,-1,-1,-1,-1,-1,-1);
+   const __m128i m11 = _mm_setr_epi8(0,-1,4,3,2,7,6,5,10,9,8,13,12,11,-1,15);
+   const __m128i m12 = _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,
+                                     -1,-1,-1,-1,-1,-1,0,-1);
+   const __m128i m21 = _mm_setr_epi8(14,-1,-1,-1,-1,-1,-1,-1,
+                                     -1,-1,-1,-1,-1,-1,-1,-1);
+   const __m128i m22 = _mm_setr_epi8(-1,3,2,1,6,5,4,9,8,7,12,11,10,15,14,13);
+   size_t i;
+
+   for (i=0; i+3*sizeof(__m128i) <= size; i += 3*sizeof(__m128i))
+   {
+      __m128i a = _mm_loadu_si128((const __m128i*)(s+i));
+      __m128i b = _mm_loadu_si128((const __m128i*)(s+i)+1);
+      __m128i c = _mm_loadu_si128((const __m128i*)(s+i)+2);
+      __m128i o0, o1, o2;
+
+      o0 = _mm_or_si128(_mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01));
+      o1 = _mm_or_si128(_mm_shuffle_epi8(a, m10), _mm_shuffle_epi8(b, m11));
+      o1 = _mm_or_si128(o1, _mm_shuffle_epi8(c, m12));
+      o2 = _mm_or_si128(_mm_shuffle_epi8(b, m21), _mm_shuffle_epi8(c, m22));
+
+      _mm_storeu_si128((__m128i*)(d+i), o0);
+      _mm_storeu_si128((__m128i*)(d+i)+1, o1);
+      _mm_storeu_si128((__m128i*)(d+i)+2, o2);
+   }
+   return i;
+}
+
+static __attribute__((target("avx2"))) size_t
+_bswap_avx2(uint8_t *d, const uint8_t *s, size_t size, __m128i mask)
+{
+   const __m256i mask2 = _mm256_broadcastsi128_si256(mask);
+   size_t i;
+
+   for (i=0; i+2*sizeof(__m256i) <= size; i += 2*sizeof(__m256i))
+   {
+      __m256i v1 = _mm256_loadu_si256((const __m256i*)(s+i));
+      __m256i v2 = _mm256_loadu_si256((const __m256i*)(s+i)+1);
+      v1 = _mm256_shuffle_epi8(v1, mask2);
+      v2 = _mm256_shuffle_epi8(v2, mask2);
+      _mm256_storeu_si256((__m256i*)(d+i), v1);
+      _mm256_storeu_si256((__m256i*)(d+i)+1, v2);
+   }
+   return i;
+}
+
+static __attribute__((target("ssse3"))) size_t
+_bswap_simd(void *dst, const void *src, size_t size, unsigned int bytes)
+{
+   enum _aaxSIMDLevel level = _aaxGetSIMDSupportLevel();
+   size_t rv = 0;
+
+   if (level >= AAX_SIMD_SSSE3 && bytes == 3) {
+      rv = _bswap24_ssse3(dst, src, size);
+   }
+   else if (level >= AAX_SIMD_SSSE3)
+   {
+      __m128i mask;
+
+      switch (bytes)
+      {
+      case 2:
+         mask = _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14);
+         break;
+      case 4:
+         mask = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+         break;
+      default:
+         mask = _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+         break;
+      }
+
+      if (level >= AAX_SIMD_AVX2) {
+         rv = _bswap_avx2(dst, src, size, mask);
+      }
+      rv += _bswap_ssse3((uint8_t*)dst+rv, (const uint8_t*)src+rv, size-rv,
+                         mask);
+   }
+   return rv;
+}
+#else
+# define _bswap_simd(d, s, n, b)	0
+#endif
+
+void
+_bswap16_array(void *dst, const void *src, size_t num)
+{
+   size_t i = _bswap_simd(dst, src, num*2, 2)/2;
+   uint8_t *d = (uint8_t*)dst;
+   const uint8_t *s = (const uint8_t*)src;
+
+   for (; i<num; ++i)
+   {
+      uint16_t v;
+      memcpy(&v, s+2*i, 2);
+      v = BSWAP16(v);
+      memcpy(d+2*i, &v, 2);
+   }
+}
+
+void
+_bswap24_array(void *dst, const void *src, size_t num)
+{
+   size_t i = _bswap_simd(dst, src, num*3, 3)/3;
+   uint8_t *d = (uint8_t*)dst + 3*i;
+   const uint8_t *s = (const uint8_t*)src + 3*i;
+
+   for (; i<num; ++i)
+   {
+      uint8_t v = s[0];
+      d[1] = s[1];
+      d[0] = s[2];
+      d[2] = v;
+      d += 3;
+      s += 3;
+   }
+}
+
+void
+_bswap32_array(void *dst, const void *src, size_t num)
+{
+   size_t i = _bswap_simd(dst, src, num*4, 4)/4;
+   uint8_t *d = (uint8_t*)dst;
+   const uint8_t *s = (const uint8_t*)src;
+
+   for (; i<num; ++i)
+   {
+      uint32_t v;
+      memcpy(&v, s+4*i, 4);
+      v = BSWAP32(v);
+      memcpy(d+4*i, &v, 4);
+   }
+}
+
+void
+_bswap64_array(void *dst, const void *src, size_t num)
+{
+   size_t i = _bswap_simd(dst, src, num*8, 8)/8;
+   uint8_t *d = (uint8_t*)dst;
+   const uint8_t *s = (const uint8_t*)src;
+
+   for (; i<num; ++i)
+   {
+      uint64_t v;
+      memcpy(&v, s+8*i, 8);
+      v = BSWAP64(v);
+      memcpy(d+8*i, &v, 8);
+   }
+}
+
 char*
 _aax_strcasestr(const char *dst, const char *src)
 {
@@ -92,3 +294,29 @@ _aax_strcasestr(const char *dst, const char *src)
    }
    return NULL;
 }
+
+enum _aaxSIMDLevel
+_aaxGetSIMDSupportLevel()
+{
+   static int level = -1;
+
+   if (level < 0)
+   {
+      const char *env = getenv("AAX_NO_SIMD");
+      int rv = AAX_SIMD_NONE;
+
+#if HAVE_X86_SIMD
+      if (!env || !atoi(env))
+      {
+         __builtin_cpu_init();
+         if (__builtin_cpu_supports("sse2")) rv = AAX_SIMD_SSE2;
+         if (__builtin_cpu_supports("ssse3")) rv = AAX_SIMD_SSSE3;
+         if (__builtin_cpu_supports("avx2")) rv = AAX_SIMD_AVX2;
+      }
+#else
+      (void)env;
+#endif
+      level = rv;
+   }
+   return level;
+}
@@ -61,6 +61,39 @@ typedef int size_t;
 
 char* _aax_strcasestr(const char*, const char*);
 
+uint16_t _bswap16(uint16_t);
+uint32_t _bswap32(uint32_t);
+uint32_t _bswap32h(uint32_t);
+uint32_t _bswap32w(uint32_t);
+uint64_t _bswap64(uint64_t);
+
+/* bulk versions, num elements, dst may be equal to src */
+void _bswap16_array(void*, const void*, size_t);
+void _bswap24_array(void*, const void*, size_t);
+void _bswap32_array(void*, const void*, size_t);
+void _bswap64_array(void*, const void*, size_t);
+
+/* x86 SIMD kernels are compiled using function target attributes */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define HAVE_X86_SIMD		1
+#endif
+
+/* ARM NEON kernels are used when the compiler targets NEON */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# define HAVE_ARM_NEON		1
+#endif
+
+enum _aaxSIMDLevel
+{
+   AAX_SIMD_NONE = 0,
+   AAX_SIMD_SSE2,
+   AAX_SIMD_SSSE3,
+   AAX_SIMD_AVX2
+};
+
+/* the highest SIMD level supported by the CPU, AAX_NO_SIMD=1 disables SIMD */
+enum _aaxSIMDLevel _aaxGetSIMDSupportLevel();
+
 #if _MSC_VER
 # include <Windows.h>
 # define strtoll _strtoi64
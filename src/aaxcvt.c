@@ -36,12 +36,32 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_STRINGS_H
+# include <strings.h>
+#endif
+#if HAVE_GLOB_H
+# include <glob.h>
+#endif
+#ifdef _WIN32
+# include <direct.h>
+# define mkdir(a, b)	_mkdir(a)
+#endif
 
 #include <aax/aax.h>
 
 #include "base/types.h"
+#include "base/threads.h"
+#include "base/lfqueue.h"
+#include "base/resample.h"
+#include "base/dither.h"
+#include "base/remix.h"
+#include "3rdparty/MurmurHash3.h"
+#include "3rdparty/ebur128.h"
 #include "driver.h"
 #include "wavfile.h"
 
@@ -49,6 +69,8 @@
 # define O_BINARY       0
 #endif
 
+#define BATCH_EXTENSIONS	"wav,aif,aiff,flac,mp3,ogg,opus"
+
 #define MAX_LOOPS		6
 static int _mask_t[MAX_LOOPS] = {
     0,
@@ -100,13 +122,49 @@ help()
 
     printf("\nOptions:\n");
     printf("  -i, --input <file>\t\tconvert audio from this WAV file\n");
-    printf("  -o, --output <file>\t\twrite the audio to this file\n");
+    printf("  -o, --output <file>\t\twrite the audio to this file, may be "
+           "repeated\n");
     printf("  -r, --raw\t\t\tdo not write the WAV file header if specified\n");
     printf("  -p, --playfs\t\t\tspecifies the playback sample rate in Hz\n");
     printf("  -f, --format <format>\t\tspecifies the output format\n");
+    printf("  -s, --samplerate <Hz>\t\tresample to this sample rate\n");
+    printf("  -q, --quality <quality>\tresampling quality: fast, medium, high "
+           "(default)\n\t\t\t\tor best\n");
+    printf("  -c, --channels <layout>\tremix the tracks: mono, stereo or a "
+           "matrix\n");
+    printf("  -n, --normalize <LUFS>\t\tnormalize the loudness (EBU R128)\n");
+    printf("  -t, --true-peak <dBTP>\tthe maximum true peak when normalizing"
+           " (-1.0)\n");
+    printf("      --start <sec>\t\tstart converting at this position\n");
+    printf("      --duration <sec>\t\tonly convert this many seconds\n");
+    printf("  -d, --dither <shape>\t\tdither for 8 and 16-bit output: off, "
+           "tpdf (default),\n\t\t\t\tshaped, lipshitz or wannamaker\n");
+    printf("  -j, --jobs <num>\t\tnumber of conversion threads in batch mode\n");
+    printf("  -m, --manifest <file>\t\tonly convert changed files in batch "
+           "mode\n");
+    printf("  -v, --verbose\t\t\tshow the conversion speed and stalls\n");
     printf("  -l, --list\t\t\tshow a list of all supported formats\n");
     printf("  -h, --help\t\t\tprint this message and exit\n");
 
+    printf("\nBatch mode is used when more than one input is specified or "
+           "when an input is\na directory or a wildcard pattern. "
+           "Directories are searched recursively.\nThe output is then a "
+           "directory or a file name template where %%n is replaced\nby the "
+           "input file name without extension, %%f by the input file name "
+           "and %%d\nby the subdirectory of the input relative to the "
+           "searched directory.\n");
+
+    printf("\nAn output may be followed by :<format> and :raw to override "
+           "the output format\nand -r for that output only, e.g. "
+           "-o out.pcm:AAX_FLOAT:raw. With more than\none output the input "
+           "is decoded once and converted to all outputs at the\nsame time."
+           " Batch mode supports one output only.\n");
+
+    printf("\nA remix matrix has a row of coefficients, one for every input "
+           "track, for every\noutput track. Rows are separated by a slash, "
+           "e.g. -c 0.5,0.5 mixes stereo\nto mono and -c 0,1/1,0 swaps the "
+           "left and right track.\n");
+
     printf("\nNote that WAV files are little endian only and AeonWave "
            "automatically\ncompensates for that.\n");
 
@@ -146,93 +204,2753 @@ list()
     }
     exit(-1);
 }
-//
-int main(int argc, char **argv)
+
+#define MAX_OUTPUTS		8
+
+struct cvtout_t
 {
+    char *file;
     enum aaxFormat format;
-    char *infile, *outfile;
-    int raw, rv = 0;
+    int raw;			/* write the audio data without a file header */
+};
 
-    if (getCommandLineOption(argc, argv, "-l") ||
-        getCommandLineOption(argc, argv, "--list"))
+struct cvtopts_t
+{
+    enum aaxFormat format;	/* default output format */
+    int raw;			/* default for writing without a file header */
+    int pipeline;		/* use a reader and a writer thread */
+    unsigned int threads;	/* threads per file, 0 for all cores */
+    unsigned int freq;		/* output sample rate, 0 to keep it */
+    enum _aaxResampleQuality quality;
+    enum _aaxDitherShape dither;	/* quantization to 8 or 16 bits */
+    const char *remix;		/* remix preset or matrix, NULL to keep */
+    int normalize;		/* normalize the loudness */
+    double loudness;		/* target loudness in LUFS */
+    double ceiling;		/* maximum true peak in dBTP */
+    double start;		/* start of the range to convert in seconds */
+    double duration;		/* length of the range, 0 for up to the end */
+};
+
+struct cvtstats_t
+{
+    unsigned int files;
+    unsigned int failed;
+    unsigned int skipped;	/* unchanged since the last conversion */
+    uint64_t bytes;
+    double duration;
+    double elapsed;
+    unsigned int stalls[3];	/* pipeline reader, converter and writer */
+    unsigned int freq[2];	/* input and output sample rate */
+    double process;		/* seconds spent resampling */
+    unsigned int tracks[2];	/* input and output tracks */
+    double remix;		/* seconds spent remixing */
+    int normalized;
+    double loudness;		/* measured loudness in LUFS */
+    double peak;		/* measured true peak in dBTP */
+    double gain;		/* applied gain in dB */
+    double shortfall;		/* dB below the target loudness */
+};
+
+static int
+writeRawFile(aaxBuffer buffer, const char *outfile, enum aaxFormat format)
+{
+    int fd, flags = O_WRONLY|O_CREAT|O_TRUNC;
+    int rv = AAX_FALSE;
+
+    if (format != AAX_AAXS16S) flags += O_BINARY;
+    fd = open(outfile, flags, 0644);
+    if (fd >= 0)
     {
-       list();
+        int size = aaxBufferGetSetup(buffer, AAX_TRACK_SIZE);
+        void **data = aaxBufferGetData(buffer);
+        if (data)
+        {
+            int res = write(fd, *data, size);
+            if (res != size) {
+                printf("Written %i bytes of the required: %i\n", res, size);
+            }
+            else rv = AAX_TRUE;
+            aaxFree(data);
+        }
+        else {
+            printf("Error: %s\n", aaxGetErrorString(aaxGetErrorNo()));
+        }
+        close(fd);
+    }
+    else {
+        printf("Unable to open file for writing: %s\n", outfile);
     }
+    return rv;
+}
 
-    if ((argc < 7) || (argc > 9))  {
-        help();
+static int
+writeData(int fd, const void *data, size_t size)
+{
+    const char *ptr = (const char*)data;
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        ssize_t res = write(fd, ptr+pos, size-pos);
+        if (res > 0) pos += res;
+        else if (res == 0 || errno != EINTR) break;
     }
+    return (pos == size) ? AAX_TRUE : AAX_FALSE;
+}
 
-    raw = getCommandLineOption(argc, argv, "-r") ? 1 : 0;
+/*
+ * Get the WAVE format tag and sample size for an output format and the
+ * little endian format to convert to before writing it to a WAVE file.
+ * Returns AAX_FALSE if the format can not be stored in a WAVE file
+ * without help of the library.
+ */
+static int
+getWaveFormat(enum aaxFormat format, struct wavinfo_t *info,
+              enum aaxFormat *wav_format)
+{
+    int rv = AAX_TRUE;
 
-    infile = getInputFile(argc, argv, NULL);
-    if (!infile)
+    info->format = 1;
+    *wav_format = format;
+    switch (format)
     {
-        printf("Input file not specified or unable to access.\n");
-        help();
-        exit(-2);
+    case AAX_PCM8S:
+    case AAX_PCM8U:
+        info->bits_sample = 8;
+        *wav_format = AAX_PCM8U;
+        break;
+    case AAX_PCM16S:
+    case AAX_PCM16S_LE:
+        info->bits_sample = 16;
+        *wav_format = AAX_PCM16S_LE;
+        break;
+    case AAX_PCM24S_PACKED:
+        info->bits_sample = 24;
+        break;
+    case AAX_PCM32S:
+    case AAX_PCM32S_LE:
+        info->bits_sample = 32;
+        *wav_format = AAX_PCM32S_LE;
+        break;
+    case AAX_FLOAT:
+    case AAX_FLOAT_LE:
+        info->format = 3;
+        info->bits_sample = 32;
+        *wav_format = AAX_FLOAT_LE;
+        break;
+    case AAX_DOUBLE:
+    case AAX_DOUBLE_LE:
+        info->format = 3;
+        info->bits_sample = 64;
+        *wav_format = AAX_DOUBLE_LE;
+        break;
+    case AAX_ALAW:
+        info->format = 6;
+        info->bits_sample = 8;
+        break;
+    case AAX_MULAW:
+        info->format = 7;
+        info->bits_sample = 8;
+        break;
+    default:
+        rv = AAX_FALSE;
+        break;
     }
-    outfile = getOutputFile(argc, argv, NULL);
-    if (!outfile) {
-       help();
+    return rv;
+}
+
+/*
+ * Convert one block of interleaved audio data. Returns the converted data
+ * which should be released using aaxFree, or NULL on error.
+ */
+static void **
+convertData(aaxConfig config, const void *data, unsigned int no_samples,
+            const struct wavinfo_t *info, enum aaxFormat in_format,
+            enum aaxFormat out_format, size_t *size)
+{
+    aaxBuffer buffer;
+    void **rv = NULL;
+
+    buffer = aaxBufferCreate(config, no_samples, info->no_tracks, in_format);
+    if (buffer)
+    {
+        if (aaxBufferSetSetup(buffer, AAX_FREQUENCY, info->freq) &&
+            aaxBufferSetData(buffer, data) &&
+            aaxBufferSetSetup(buffer, AAX_FORMAT, out_format))
+        {
+            rv = aaxBufferGetData(buffer);
+            *size = (size_t)no_samples*info->no_tracks*
+                    aaxGetBitsPerSample(out_format)/8;
+        }
+        aaxBufferDestroy(buffer);
     }
+    return rv;
+}
 
-    format = getAudioFormat(argc, argv, AAX_FORMAT_NONE);
-    if (format == AAX_AAXS16S) raw = AAX_TRUE;
+/*
+ * Returns the resolution to dither to when audio in the input format is
+ * converted to the output format, or 0 if no dithering is required.
+ */
+static unsigned int
+getDitherBits(enum aaxFormat in_format, enum aaxFormat out_format)
+{
+    unsigned int bits = 0;
 
-    if (format != AAX_FORMAT_NONE)
+    switch (out_format & AAX_FORMAT_NATIVE)
     {
-        char *rfs = getCommandLineOption(argc, argv, "-p");
-        aaxConfig config;
-        aaxBuffer buffer;
+    case AAX_PCM8S:
+        bits = 8;
+        break;
+    case AAX_PCM16S:
+        bits = 16;
+        break;
+    default:
+        break;
+    }
+    if (bits && aaxGetBitsPerSample(in_format & AAX_FORMAT_NATIVE) <= bits) {
+        bits = 0;
+    }
+    return bits;
+}
 
-        config=aaxDriverOpenByName("AeonWave Loopback", AAX_MODE_WRITE_STEREO);
-        if (rfs) {
-            aaxMixerSetSetup(config, AAX_FREQUENCY, atoi(rfs));
-         }
+/*
+ * Quantize interleaved float audio to the native 16-bit signed or 8-bit
+ * unsigned format using the ditherer. The result should be released using
+ * free and is NULL on error.
+ */
+static void *
+ditherData(_aaxDither *dither, const float *data, unsigned int no_samples,
+           unsigned int tracks, unsigned int bits, enum aaxFormat *format)
+{
+    void *rv = malloc((size_t)no_samples*tracks*bits/8);
+    if (rv)
+    {
+        _aaxDitherProcess(dither, rv, data, no_samples);
+        *format = (bits == 16) ? AAX_PCM16S : AAX_PCM8U;
+    }
+    return rv;
+}
 
-        buffer = bufferFromFile(config, infile);
-        if (buffer)
+/*
+ * Check whether a WAVE file can be converted in blocks and get the input
+ * format, the format to convert to and the output WAVE format.
+ */
+static int
+getStreamFormats(enum aaxFormat format, int raw, const struct wavinfo_t *info,
+                 enum aaxFormat *in_format, enum aaxFormat *out_format,
+                 struct wavinfo_t *out)
+{
+    memset(out, 0, sizeof(struct wavinfo_t));
+    *out_format = format;
+    if (format == AAX_IMA4_ADPCM || format == AAX_AAXS16S ||
+        format == AAX_PCM24S) {
+        return AAX_FALSE;
+    }
+    if (!raw && !getWaveFormat(format, out, out_format)) {
+        return AAX_FALSE;
+    }
+
+    *in_format = getFormatFromFileFormat(info->format, info->bits_sample);
+    if (*in_format == AAX_FORMAT_NONE || *in_format == AAX_IMA4_ADPCM) {
+        return AAX_FALSE;
+    }
+
+    out->no_tracks = info->no_tracks;
+    out->freq = info->freq;
+    out->block = out->no_tracks*out->bits_sample/8;
+
+    return AAX_TRUE;
+}
+
+/*
+ * Get the remix matrix for a number of input tracks from a preset name or
+ * from rows of comma separated coefficients separated by a slash.
+ * Returns the number of output tracks or 0 on error.
+ */
+static unsigned int
+getRemixMatrix(const char *str, unsigned int in_tracks, float *matrix)
+{
+    unsigned int rv, num = 0;
+    const char *ptr = str;
+
+    rv = _aaxRemixGetPreset(str, in_tracks, matrix);
+    if (rv || in_tracks > AAX_REMIX_MAX_TRACKS) return rv;
+
+    do
+    {
+        char *end;
+        double v;
+
+        v = strtod(ptr, &end);
+        if (end == ptr || num == AAX_REMIX_MAX_TRACKS*in_tracks) return 0;
+        matrix[num++] = v;
+
+        ptr = end;
+        if (*ptr == '/' || *ptr == '\0')
         {
-            aaxBufferSetSetup(buffer, AAX_FORMAT, format);
-            if (!raw) {
-               aaxBufferWriteToFile(buffer, outfile, AAX_OVERWRITE);
-            }
-            else
-            {
-               int fd, flags = O_WRONLY|O_CREAT|O_TRUNC;
-
-               if (format != AAX_AAXS16S) flags += O_BINARY;
-               fd = open(outfile, flags, 0644);
-               if (fd >= 0)
-               {
-                  int size = aaxBufferGetSetup(buffer, AAX_TRACK_SIZE);
-                  void **data = aaxBufferGetData(buffer);
-                  if (data)
-                  {
-                     int res = write(fd, *data, size);
-                     if (res != size) {
-                        printf("Written %i bytes of the required: %i\n", res, size);
-                     }
-                  }
-                  else {
-                     printf("Error: %s\n", aaxGetErrorString(aaxGetErrorNo()));
-                  }
-                  close(fd);
-               }
-               else {
-                  printf("Unable to open file for writing: %s\n", outfile);
-               }
-            }
-            aaxBufferDestroy(buffer);
+            /* every row needs a coefficient for every input track */
+            if (num % in_tracks) return 0;
+            rv++;
         }
-        aaxDriverDestroy(config);
+        else if (*ptr != ',') return 0;
     }
-    else {
-        printf("Unsupported audio format.\n");
-        rv = -2;
+    while (*ptr++);
+
+    return rv;
+}
+
+/*
+ * The processing stage between reading and writing. Blocks which need
+ * processing are converted to 32-bit float, remixed and resampled and then
+ * converted to the output format, other blocks are converted directly.
+ * Remixing is done first so downmixed audio has fewer tracks to resample.
+ */
+typedef struct
+{
+    struct wavinfo_t info;	/* format of the processed audio */
+    unsigned int in_freq;
+    unsigned int in_tracks;
+    _aaxRemix *remix;
+    float *mixed;		/* remixed audio of the current block */
+    size_t mixed_max;
+    _aaxResample *resample;
+    _aaxTimer *timer;
+    double time;		/* seconds spent resampling */
+    double remix_time;		/* seconds spent remixing */
+} _cvt_process_t;
+
+static void processDestroy(_cvt_process_t*, struct cvtstats_t*);
+
+static int
+processInit(_cvt_process_t *proc, const struct cvtopts_t *opts,
+            const struct wavinfo_t *info)
+{
+    memset(proc, 0, sizeof(_cvt_process_t));
+    proc->info.no_tracks = proc->in_tracks = info->no_tracks;
+    proc->info.freq = proc->in_freq = info->freq;
+
+    if (opts->remix)
+    {
+        float matrix[AAX_REMIX_MAX_TRACKS*AAX_REMIX_MAX_TRACKS];
+        unsigned int i, tracks;
+        int identity;
+
+        tracks = getRemixMatrix(opts->remix, info->no_tracks, matrix);
+        identity = (tracks == info->no_tracks);
+        for (i=0; identity && i<tracks*tracks; ++i) {
+            identity = (matrix[i] == ((i % (tracks+1)) ? 0.0f : 1.0f));
+        }
+
+        if (tracks && !identity) {
+            proc->remix = _aaxRemixCreate(info->no_tracks, tracks, matrix);
+        }
+        if (!tracks || (!identity && !proc->remix))
+        {
+            printf("Unable to remix %u tracks using: %s\n",
+                   info->no_tracks, opts->remix);
+            return AAX_FALSE;
+        }
+        proc->info.no_tracks = tracks;
+    }
+
+    if (opts->freq && opts->freq != info->freq)
+    {
+        proc->resample = _aaxResampleCreate(proc->info.no_tracks, info->freq,
+                                            opts->freq, opts->quality);
+        if (!proc->resample)
+        {
+            printf("Unable to resample from %u Hz to %u Hz\n",
+                   info->freq, opts->freq);
+            processDestroy(proc, NULL);
+            return AAX_FALSE;
+        }
+        proc->info.freq = opts->freq;
+    }
+
+    if (proc->remix || proc->resample)
+    {
+        proc->timer = _aaxTimerCreate();
+        if (!proc->timer)
+        {
+            processDestroy(proc, NULL);
+            return AAX_FALSE;
+        }
     }
+    return AAX_TRUE;
+}
+
+static void
+processDestroy(_cvt_process_t *proc, struct cvtstats_t *stats)
+{
+    if (stats && proc->resample)
+    {
+        stats->freq[0] = proc->in_freq;
+        stats->freq[1] = proc->info.freq;
+        stats->process = proc->time;
+    }
+    if (stats && proc->remix)
+    {
+        stats->tracks[0] = proc->in_tracks;
+        stats->tracks[1] = proc->info.no_tracks;
+        stats->remix = proc->remix_time;
+    }
+    _aaxRemixDestroy(proc->remix);
+    _aaxResampleDestroy(proc->resample);
+    _aaxTimerDestroy(proc->timer);
+    free(proc->mixed);
+    proc->remix = NULL;
+    proc->resample = NULL;
+    proc->timer = NULL;
+    proc->mixed = NULL;
+}
+
+/*
+ * Remix and resample a number of interleaved float frames, without frames
+ * the resampler is flushed. Returns AAX_FALSE on error, otherwise ptr
+ * refers to the processed frames, which stay valid until the next call,
+ * and frames is set to their number.
+ */
+static int
+processFrames(_cvt_process_t *proc, const float *src, size_t *frames,
+              float **ptr)
+{
+    *ptr = (float*)src;
+    if (src && proc->remix)
+    {
+        size_t len = *frames*proc->info.no_tracks;
+
+        if (len > proc->mixed_max)
+        {
+            float *mixed = realloc(proc->mixed, len*sizeof(float));
+            if (!mixed) return AAX_FALSE;
+
+            proc->mixed = mixed;
+            proc->mixed_max = len;
+        }
+
+        _aaxTimerStart(proc->timer);
+        _aaxRemixProcess(proc->remix, proc->mixed, src, *frames);
+        proc->remix_time += _aaxTimerElapsed(proc->timer);
+        *ptr = proc->mixed;
+    }
+
+    if (proc->resample)
+    {
+        _aaxTimerStart(proc->timer);
+        if (src) {
+            *frames = _aaxResampleProcess(proc->resample, *ptr, *frames, ptr);
+        } else {
+            *frames = _aaxResampleFlush(proc->resample, ptr);
+        }
+        proc->time += _aaxTimerElapsed(proc->timer);
+    }
+    else if (!src) {
+        *frames = 0;
+    }
+    return AAX_TRUE;
+}
+
+/*
+ * A block of audio ready to be converted to the output format(s).
+ */
+typedef struct
+{
+    const void *data;
+    unsigned int no_samples;
+    const struct wavinfo_t *info;
+    enum aaxFormat format;
+} _cvt_audio_t;
+
+/*
+ * Process one block of interleaved audio data. A block without data flushes
+ * the processing stage at the end of the stream. Without processing the
+ * audio refers to the input data, otherwise it refers to data which stays
+ * valid until the next call.
+ * Returns AAX_FALSE on error.
+ */
+static int
+processBlock(aaxConfig config, _cvt_process_t *proc, const void *data,
+             unsigned int no_samples, const struct wavinfo_t *info,
+             enum aaxFormat format, _cvt_audio_t *audio)
+{
+    size_t frames = no_samples;
+    void **fdata = NULL;
+    float *ptr = NULL;
+    int rv;
+
+    audio->data = data;
+    audio->no_samples = no_samples;
+    audio->info = info;
+    audio->format = format;
+    if (!proc->resample && !proc->remix) return AAX_TRUE;
+
+    if (data)
+    {
+        size_t fsize;
+
+        fdata = convertData(config, data, no_samples, info, format,
+                            AAX_FLOAT, &fsize);
+        if (!fdata) return AAX_FALSE;
+        ptr = *fdata;
+    }
+    rv = processFrames(proc, ptr, &frames, &ptr);
+    aaxFree(fdata);
+    if (!rv) return AAX_FALSE;
+
+    audio->data = ptr;
+    audio->no_samples = frames;
+    audio->info = &proc->info;
+    audio->format = AAX_FLOAT;
+
+    return AAX_TRUE;
+}
+
+/*
+ * Open the output file and write a WAVE header with empty sizes,
+ * finishOutput patches up the header when all data is written.
+ */
+static int
+openOutput(const char *outfile, int raw, const struct wavinfo_t *out)
+{
+    int fd = open(outfile, O_WRONLY|O_CREAT|O_TRUNC|O_BINARY, 0644);
+    if (fd < 0) {
+        printf("Unable to open file for writing: %s\n", outfile);
+    }
+    else if (!raw && !wavHeaderWrite(fd, out))
+    {
+        printf("Error writing to: %s\n", outfile);
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static int
+finishOutput(int fd, int raw, struct wavinfo_t *out, uint64_t written)
+{
+    int rv = AAX_TRUE;
+
+    if (!raw)
+    {
+        out->data_size = written;
+        out->no_samples = written/out->block;
+        if (written & 1) rv = writeData(fd, "", 1);
+        if (rv) rv = (wavHeaderWrite(fd, out) > 0);
+    }
+    close(fd);
+
+    return rv;
+}
+
+/*
+ * Every output of a streaming conversion has its own writer which converts
+ * the (processed) audio blocks to its own format.
+ */
+typedef struct
+{
+    const struct cvtout_t *output;
+    enum aaxFormat format;	/* format to convert to */
+    unsigned int swap;		/* sample size to byte swap afterwards */
+    struct wavinfo_t info;	/* output WAVE format */
+    _aaxDither *dither;
+    int fd;
+    uint64_t written;
+    int error;
+} _cvt_writer_t;
+
+/*
+ * Big endian output is converted to little endian by the library and
+ * byte swapped in bulk afterwards. Returns the sample size to swap and
+ * the format to convert to, or 0 if the library does all the work.
+ */
+static unsigned int
+getSwapFormat(enum aaxFormat format, enum aaxFormat *le_format)
+{
+    int mask = format & ~AAX_FORMAT_NATIVE;
+    unsigned int rv = 0;
+
+    *le_format = format;
+    if (mask == AAX_FORMAT_BE || mask == AAX_FORMAT_BE_UNSIGNED)
+    {
+        switch (format & AAX_FORMAT_NATIVE)
+        {
+        case AAX_PCM16S:
+            rv = 2;
+            break;
+        case AAX_PCM24S_PACKED:
+            rv = 3;
+            break;
+        case AAX_PCM32S:
+        case AAX_FLOAT:
+            rv = 4;
+            break;
+        case AAX_DOUBLE:
+            rv = 8;
+            break;
+        default:
+            break;
+        }
+        if (rv)
+        {
+            mask = (mask == AAX_FORMAT_BE) ? AAX_FORMAT_LE
+                                           : AAX_FORMAT_LE_UNSIGNED;
+            *le_format = (format & AAX_FORMAT_NATIVE) | mask;
+        }
+    }
+    return rv;
+}
+
+/*
+ * Set up the writers for all outputs and get the input format.
+ * Returns AAX_FALSE if one of the outputs can not be streamed.
+ */
+static int
+getWriters(const struct cvtout_t *outputs, unsigned int num,
+           const struct wavinfo_t *info, enum aaxFormat *in_format,
+           _cvt_writer_t *writers)
+{
+    unsigned int i;
+
+    memset(writers, 0, num*sizeof(_cvt_writer_t));
+    for (i=0; i<num; ++i)
+    {
+        _cvt_writer_t *w = &writers[i];
+
+        w->output = &outputs[i];
+        w->fd = -1;
+        if (!getStreamFormats(outputs[i].format, outputs[i].raw, info,
+                              in_format, &w->format, &w->info)) {
+            return AAX_FALSE;
+        }
+        w->swap = getSwapFormat(w->format, &w->format);
+    }
+    return AAX_TRUE;
+}
+
+/*
+ * Open the output files. Every writer which converts to 8 or 16 bits gets
+ * its own ditherer, the seed only depends on the output number so the
+ * same input always results in the same output.
+ */
+static int
+openWriters(_cvt_writer_t *writers, unsigned int num,
+            const struct wavinfo_t *info, enum _aaxDitherShape dither)
+{
+    unsigned int i;
+
+    for (i=0; i<num; ++i)
+    {
+        _cvt_writer_t *w = &writers[i];
+        unsigned int bits;
+
+        /* the processed audio may have another number of tracks */
+        w->info.freq = info->freq;
+        w->info.no_tracks = info->no_tracks;
+        w->info.block = w->info.no_tracks*w->info.bits_sample/8;
+
+        bits = getDitherBits(AAX_FLOAT, w->format);
+        if (bits && dither != AAX_DITHER_OFF)
+        {
+            w->dither = _aaxDitherCreate(w->info.no_tracks, bits, dither, i);
+            if (!w->dither) return AAX_FALSE;
+        }
+
+        w->fd = openOutput(w->output->file, w->output->raw, &w->info);
+        if (w->fd < 0) return AAX_FALSE;
+    }
+    return AAX_TRUE;
+}
+
+static int
+closeWriters(_cvt_writer_t *writers, unsigned int num)
+{
+    int rv = AAX_TRUE;
+    unsigned int i;
 
+    for (i=0; i<num; ++i)
+    {
+        _cvt_writer_t *w = &writers[i];
+
+        if (w->fd >= 0 &&
+            !finishOutput(w->fd, w->output->raw, &w->info, w->written)) {
+            rv = AAX_FALSE;
+        }
+        if (w->error) rv = AAX_FALSE;
+        _aaxDitherDestroy(w->dither);
+        w->dither = NULL;
+        w->fd = -1;
+    }
     return rv;
 }
 
+/*
+ * Convert a block of audio to the output format and write it. Audio with
+ * a higher resolution than the output is dithered first.
+ * Once an error occured the writer skips all remaining blocks.
+ */
+static int
+writeBlock(aaxConfig config, _cvt_writer_t *w, const _cvt_audio_t *audio)
+{
+    enum aaxFormat format = audio->format;
+    const void *ptr = audio->data;
+    void *dithered = NULL;
+    void **data = NULL;
+    unsigned int bits;
+    size_t size;
+
+    if (w->error || !audio->no_samples) return !w->error;
+
+    bits = w->dither ? getDitherBits(format, w->format) : 0;
+    if (bits)
+    {
+        void **fdata = NULL;
+
+        if (format != AAX_FLOAT) {
+            fdata = convertData(config, ptr, audio->no_samples, audio->info,
+                                format, AAX_FLOAT, &size);
+        }
+        if (format == AAX_FLOAT || fdata)
+        {
+            dithered = ditherData(w->dither, fdata ? *fdata : ptr,
+                                  audio->no_samples, audio->info->no_tracks,
+                                  bits, &format);
+        }
+        aaxFree(fdata);
+        ptr = dithered;
+    }
+
+    if (ptr) {
+        data = convertData(config, ptr, audio->no_samples, audio->info,
+                           format, w->format, &size);
+    }
+    if (data)
+    {
+        switch (w->swap)
+        {
+        case 2:
+            _bswap16_array(*data, *data, size/2);
+            break;
+        case 3:
+            _bswap24_array(*data, *data, size/3);
+            break;
+        case 4:
+            _bswap32_array(*data, *data, size/4);
+            break;
+        case 8:
+            _bswap64_array(*data, *data, size/8);
+            break;
+        default:
+            break;
+        }
+    }
+    if (data && writeData(w->fd, *data, size)) {
+        w->written += size;
+    }
+    else
+    {
+        printf("Error %s: %s\n", data ? "writing to" : "converting to",
+               w->output->file);
+        w->error = AAX_TRUE;
+    }
+    aaxFree(data);
+    free(dithered);
+
+    return !w->error;
+}
+
+/*
+ * Get the range of samples to convert from the start and duration options
+ * for a file with the given sample rate. Returns AAX_FALSE if the whole
+ * file has to be converted.
+ */
+static int
+getRange(const struct cvtopts_t *opts, unsigned int freq, uint64_t *start,
+         uint64_t *length)
+{
+    *start = (uint64_t)(opts->start*freq);
+    *length = (uint64_t)(opts->duration*freq + 0.5);
+    return (*start || *length) ? AAX_TRUE : AAX_FALSE;
+}
+
+/*
+ * Streaming conversion of WAVE files: fixed size blocks are read, converted
+ * and written one at a time so memory usage does not depend on the file
+ * size. Every block is decoded and processed once and then written to all
+ * outputs. The WAVE headers are written with empty sizes first and patched
+ * up when all data is written.
+ * Returns -1 if the file or one of the formats can not be streamed.
+ */
+#define STREAM_BLOCK_SIZE	(256*1024)
+
+static int
+convertStream(aaxConfig config, const char *infile,
+              const struct cvtout_t *outputs, unsigned int num,
+              const struct cvtopts_t *opts, struct cvtstats_t *stats)
+{
+    _cvt_writer_t writers[MAX_OUTPUTS];
+    struct wavstream_t *stream;
+    enum aaxFormat in_format;
+    struct wavinfo_t info;
+    uint64_t start, length;
+    _cvt_process_t proc;
+    int rv = AAX_TRUE;
+    unsigned int i;
+
+    /* the sample rate is required to get the range in samples */
+    start = length = 0;
+    if ((opts->start || opts->duration) &&
+        (fileProbe(infile, &info, NULL) != 0 ||
+         !getRange(opts, info.freq, &start, &length)))
+    {
+        return -1;
+    }
+
+    stream = wavStreamOpenRange(infile, &info, STREAM_BLOCK_SIZE, 0,
+                                start, length);
+    if (!stream) return -1;
+
+    if (!getWriters(outputs, num, &info, &in_format, writers))
+    {
+        wavStreamClose(stream);
+        return -1;
+    }
+
+    if (!processInit(&proc, opts, &info))
+    {
+        wavStreamClose(stream);
+        return AAX_FALSE;
+    }
+
+    if (!openWriters(writers, num, &proc.info, opts->dither)) {
+        rv = AAX_FALSE;
+    }
+    while (rv)
+    {
+        const void *block;
+        _cvt_audio_t audio;
+        ssize_t len;
+
+        len = wavStreamRead(stream, &block);
+        if (len < 0)
+        {
+            printf("Error reading from: %s\n", infile);
+            rv = AAX_FALSE;
+            break;
+        }
+
+        /* an empty block flushes the processing stage */
+        if (processBlock(config, &proc, len ? block : NULL, len/info.block,
+                         &info, in_format, &audio))
+        {
+            for (i=0; i<num; ++i) {
+                if (!writeBlock(config, &writers[i], &audio)) rv = AAX_FALSE;
+            }
+        }
+        else
+        {
+            printf("Error converting: %s\n", infile);
+            rv = AAX_FALSE;
+        }
+
+        if (len == 0) break;
+    }
+
+    if (!closeWriters(writers, num)) rv = AAX_FALSE;
+    processDestroy(&proc, stats);
+    wavStreamClose(stream);
+
+    if (stats)
+    {
+        stats->duration = info.freq ? (double)info.no_samples/info.freq : 0;
+        if (start || length) stats->bytes = info.data_size;
+    }
+
+    return rv;
+}
+
+#if !NO_THREADS
+/*
+ * Pipelined conversion: a reader thread, the processing stage on the
+ * calling thread and a writer thread for every output pass a fixed set of
+ * reusable blocks around using lock-free queues, so reading, processing,
+ * converting and writing overlap:
+ *
+ *   reader -> filled -> processing -> todo[n] -> writer[n] -> done[n] -> reader
+ *
+ * The processed audio of a block is shared read-only by all writers, every
+ * writer converts it to its own output format. The reader reuses a block
+ * once all writers are done with it. Every queue can hold all blocks so
+ * pushing never fails, a stage stalls when its input queue is empty.
+ * A block with a length of zero marks the end of the data. After an error
+ * the stages keep passing on blocks, without processing them, until the
+ * end marker reaches the writers.
+ */
+#define PIPELINE_BLOCK_SIZE	(256*1024)
+#define PIPELINE_NUM_BLOCKS	8
+
+enum {
+    STAGE_READER = 0,
+    STAGE_CONVERTER,
+    STAGE_WRITER,
+
+    MAX_STAGES
+};
+
+typedef struct
+{
+    void *data;
+    size_t len;			/* bytes of input data, 0 at the end */
+    float *processed;		/* processed audio, if any */
+    size_t processed_max;
+    _cvt_audio_t audio;		/* the audio to write */
+    unsigned int refs;		/* writers which still use the block */
+    int error;
+} _cvt_block_t;
+
+typedef struct
+{
+    _cvt_writer_t *writer;
+    aaxConfig config;
+    _aaxLFQueue *todo;
+    _aaxLFQueue *done;
+    _aaxThread thread;
+    unsigned int stalls;
+} _cvt_encoder_t;
+
+typedef struct
+{
+    int in_fd;
+    uint64_t remain;		/* bytes of input data left to read */
+    size_t block_size;
+
+    _cvt_block_t *free[PIPELINE_NUM_BLOCKS]; /* only used by the reader */
+    unsigned int num_free;
+
+    _aaxLFQueue *filled;
+    _cvt_encoder_t encoders[MAX_OUTPUTS];
+    unsigned int num_encoders;
+    unsigned int stalls[MAX_STAGES];
+} _cvt_pipeline_t;
+
+static _cvt_block_t *
+waitForBlock(_aaxLFQueue *q, unsigned int *stalls)
+{
+    _cvt_block_t *rv = _aaxLFQueuePop(q);
+    if (!rv)
+    {
+        unsigned int dt = 10;
+
+        (*stalls)++;
+        do
+        {
+            usecSleep(dt);
+            if (dt < 1000) dt *= 2;
+        }
+        while ((rv = _aaxLFQueuePop(q)) == NULL);
+    }
+    return rv;
+}
+
+/* collect the blocks which all writers are done with */
+static _cvt_block_t *
+waitForFreeBlock(_cvt_pipeline_t *p)
+{
+    unsigned int i, dt = 10;
+    int stalled = AAX_FALSE;
+
+    while (!p->num_free)
+    {
+        for (i=0; i<p->num_encoders; ++i)
+        {
+            _cvt_block_t *block;
+
+            while ((block = _aaxLFQueuePop(p->encoders[i].done)) != NULL) {
+                if (--block->refs == 0) p->free[p->num_free++] = block;
+            }
+        }
+
+        if (!p->num_free)
+        {
+            if (!stalled) p->stalls[STAGE_READER]++;
+            stalled = AAX_TRUE;
+            usecSleep(dt);
+            if (dt < 1000) dt *= 2;
+        }
+    }
+    return p->free[--p->num_free];
+}
+
+static void*
+_pipelineReader(void *id)
+{
+    _cvt_pipeline_t *p = (_cvt_pipeline_t*)id;
+    int error = AAX_FALSE;
+    _cvt_block_t *block;
+
+    do
+    {
+        size_t len;
+
+        block = waitForFreeBlock(p);
+        len = _MIN(p->block_size, p->remain);
+        block->len = 0;
+        block->error = error;
+        if (!error)
+        {
+            uint8_t *ptr = (uint8_t*)block->data;
+            size_t pos = 0;
+
+            while (pos < len)
+            {
+                ssize_t res = read(p->in_fd, ptr+pos, len-pos);
+                if (res > 0) pos += res;
+                else if (res == 0 || errno != EINTR) break;
+            }
+            if (pos == len)
+            {
+                block->len = len;
+                p->remain -= len;
+            }
+            else {
+                block->error = error = AAX_TRUE;
+            }
+        }
+        _aaxLFQueuePush(p->filled, block);
+    }
+    while (block->len);
+
+    return NULL;
+}
+
+static void*
+_pipelineWriter(void *id)
+{
+    _cvt_encoder_t *e = (_cvt_encoder_t*)id;
+    _cvt_block_t *block;
+
+    do
+    {
+        block = waitForBlock(e->todo, &e->stalls);
+        if (!block->error) writeBlock(e->config, e->writer, &block->audio);
+        if (block->len) _aaxLFQueuePush(e->done, block);
+    }
+    while (block->len);
+
+    return NULL;
+}
+
+/*
+ * The processed audio is only valid until the next block is processed,
+ * keep a copy in the block for the writers.
+ */
+static int
+keepProcessed(_cvt_block_t *block)
+{
+    const _cvt_audio_t *audio = &block->audio;
+    size_t len = (size_t)audio->no_samples*audio->info->no_tracks;
+
+    if (len > block->processed_max)
+    {
+        float *ptr = realloc(block->processed, len*sizeof(float));
+        if (!ptr) return AAX_FALSE;
+
+        block->processed = ptr;
+        block->processed_max = len;
+    }
+    if (len) memcpy(block->processed, audio->data, len*sizeof(float));
+    block->audio.data = block->processed;
+
+    return AAX_TRUE;
+}
+
+/* stop the writers which are already running */
+static void
+stopWriters(_cvt_pipeline_t *p, _cvt_block_t *block, unsigned int num)
+{
+    unsigned int i;
+
+    block->len = 0;
+    block->error = AAX_TRUE;
+    for (i=0; i<num; ++i) {
+        _aaxLFQueuePush(p->encoders[i].todo, block);
+    }
+    for (i=0; i<num; ++i) {
+        _aaxThreadJoin(p->encoders[i].thread);
+    }
+}
+
+/*
+ * Returns -1 if the file or one of the formats can not be streamed or when
+ * the threads could not be created.
+ */
+static int
+convertPipeline(aaxConfig config, const char *infile,
+                const struct cvtout_t *outputs, unsigned int num,
+                const struct cvtopts_t *opts, struct cvtstats_t *stats)
+{
+    _cvt_block_t blocks[PIPELINE_NUM_BLOCKS];
+    _cvt_writer_t writers[MAX_OUTPUTS];
+    enum aaxFormat in_format;
+    _cvt_process_t proc;
+    struct wavinfo_t info;
+    _cvt_pipeline_t p;
+    uint64_t file_size;
+    uint64_t start, length;
+    _aaxThread reader;
+    unsigned int i, started = 0;
+    int rv = -1;
+
+    if (fileProbe(infile, &info, &file_size) != 0 || !info.block) return -1;
+    if (getRange(opts, info.freq, &start, &length))
+    {
+        wavInfoSetRange(&info, start, length);
+        if (!info.data_size) return -1;
+    }
+    if (!getWriters(outputs, num, &info, &in_format, writers)) return -1;
+    if (!processInit(&proc, opts, &info)) return AAX_FALSE;
+
+    memset(&p, 0, sizeof(p));
+    memset(blocks, 0, sizeof(blocks));
+    p.remain = info.data_size;
+    p.block_size = PIPELINE_BLOCK_SIZE - PIPELINE_BLOCK_SIZE % info.block;
+    if (!p.block_size) p.block_size = info.block;
+
+    p.filled = _aaxLFQueueCreate(PIPELINE_NUM_BLOCKS);
+    for (i=0; i<PIPELINE_NUM_BLOCKS; ++i)
+    {
+        blocks[i].data = malloc(p.block_size);
+        if (!blocks[i].data) break;
+        p.free[p.num_free++] = &blocks[i];
+    }
+
+    /* every writer converts using its own loopback configuration */
+    for (p.num_encoders=0; p.num_encoders<num; ++p.num_encoders)
+    {
+        _cvt_encoder_t *e = &p.encoders[p.num_encoders];
+
+        e->writer = &writers[p.num_encoders];
+        e->todo = _aaxLFQueueCreate(PIPELINE_NUM_BLOCKS);
+        e->done = _aaxLFQueueCreate(PIPELINE_NUM_BLOCKS);
+        e->config = aaxDriverOpenByName("AeonWave Loopback",
+                                        AAX_MODE_WRITE_STEREO);
+        if (!e->todo || !e->done || !e->config) break;
+        aaxMixerSetSetup(e->config, AAX_FREQUENCY,
+                         aaxMixerGetSetup(config, AAX_FREQUENCY));
+    }
+
+    p.in_fd = open(infile, O_RDONLY|O_BINARY);
+    if (p.num_free == PIPELINE_NUM_BLOCKS && p.num_encoders == num &&
+        p.filled && p.in_fd >= 0 &&
+        lseek(p.in_fd, (off_t)info.data_offset, SEEK_SET) >= 0)
+    {
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(p.in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (!openWriters(writers, num, &proc.info, opts->dither)) {
+            rv = AAX_FALSE;
+        }
+
+        for (i=0; rv < 0 && i<num; ++i)
+        {
+            _cvt_encoder_t *e = &p.encoders[i];
+            if (_aaxThreadCreate(&e->thread, _pipelineWriter, e) != 0) break;
+            started++;
+        }
+
+        if (started == num &&
+            _aaxThreadCreate(&reader, _pipelineReader, &p) == 0)
+        {
+            int error = AAX_FALSE;
+            _cvt_block_t *block;
+
+            do
+            {
+                block = waitForBlock(p.filled, &p.stalls[STAGE_CONVERTER]);
+                if (block->error) error = AAX_TRUE;
+                if (!error)
+                {
+                    /* the end marker carries the flushed output */
+                    void *data = block->len ? block->data : NULL;
+                    if (!processBlock(config, &proc, data,
+                                      block->len/info.block, &info,
+                                      in_format, &block->audio) ||
+                        ((proc.resample || proc.remix) &&
+                         !keepProcessed(block)))
+                    {
+                        printf("Error converting: %s\n", infile);
+                        error = AAX_TRUE;
+                    }
+                }
+                block->error = error;
+                block->refs = num;
+                for (i=0; i<num; ++i) {
+                    _aaxLFQueuePush(p.encoders[i].todo, block);
+                }
+            }
+            while (block->len);
+
+            _aaxThreadJoin(reader);
+            for (i=0; i<num; ++i) {
+                _aaxThreadJoin(p.encoders[i].thread);
+            }
+            rv = !error;
+        }
+        else
+        {
+            /* the output is rewritten by the next method */
+            stopWriters(&p, &blocks[0], started);
+        }
+
+        if (!closeWriters(writers, num) && rv > 0) rv = AAX_FALSE;
+    }
+    if (p.in_fd >= 0) close(p.in_fd);
+
+    for (i=0; i<num; ++i)
+    {
+        _cvt_encoder_t *e = &p.encoders[i];
+
+        if (e->config) aaxDriverDestroy(e->config);
+        _aaxLFQueueDestroy(e->done);
+        _aaxLFQueueDestroy(e->todo);
+        p.stalls[STAGE_WRITER] += e->stalls;
+    }
+    for (i=0; i<PIPELINE_NUM_BLOCKS; ++i)
+    {
+        free(blocks[i].processed);
+        free(blocks[i].data);
+    }
+    _aaxLFQueueDestroy(p.filled);
+    processDestroy(&proc, stats);
+
+    if (stats)
+    {
+        stats->duration = info.freq ? (double)info.no_samples/info.freq : 0;
+        if (start || length) stats->bytes = info.data_size;
+        for (i=0; i<MAX_STAGES; ++i) {
+            stats->stalls[i] = p.stalls[i];
+        }
+    }
+
+    return rv;
+}
+#endif
+
+/*
+ * Process the audio of a buffer as a whole. Returns a new buffer with the
+ * processed audio, the buffer itself if there is nothing to process or
+ * NULL on error. The buffer is destroyed if it is replaced.
+ */
+#define PROCESS_BLOCK_FRAMES	65536
+
+static aaxBuffer
+processBuffer(aaxConfig config, aaxBuffer buffer, const struct cvtopts_t *opts,
+              struct cvtstats_t *stats)
+{
+    struct wavinfo_t info;
+    _cvt_process_t proc;
+    aaxBuffer rv = NULL;
+    void **data = NULL;
+
+    memset(&info, 0, sizeof(info));
+    info.no_tracks = aaxBufferGetSetup(buffer, AAX_TRACKS);
+    info.freq = aaxBufferGetSetup(buffer, AAX_FREQUENCY);
+    info.no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+    if ((!opts->freq || opts->freq == info.freq) && !opts->remix) {
+        return buffer;
+    }
+
+    if (processInit(&proc, opts, &info))
+    {
+        if (!proc.resample && !proc.remix)
+        {
+            processDestroy(&proc, NULL);
+            return buffer;
+        }
+        if (aaxBufferSetSetup(buffer, AAX_FORMAT, AAX_FLOAT)) {
+            data = aaxBufferGetData(buffer);
+        }
+    }
+
+    if (data)
+    {
+        unsigned int tracks = proc.info.no_tracks;
+        size_t max, pos = 0, frames = 0;
+        const float *src = *data;
+        float *dst, *ptr;
+
+        max = ((uint64_t)info.no_samples*proc.info.freq + info.freq-1) /
+              info.freq;
+        dst = malloc(_MAX(max, 1)*tracks*sizeof(float));
+        while (dst)
+        {
+            size_t num, len;
+
+            /* a block without data flushes the resampler */
+            len = num = _MIN(info.no_samples-pos, PROCESS_BLOCK_FRAMES);
+            if (!processFrames(&proc, len ? src+pos*info.no_tracks : NULL,
+                               &num, &ptr))
+            {
+                free(dst);
+                dst = NULL;
+                break;
+            }
+
+            num = _MIN(num, max-frames);
+            memcpy(dst+frames*tracks, ptr, num*tracks*sizeof(float));
+            frames += num;
+            pos += len;
+            if (!len) break;
+        }
+        aaxFree(data);
+
+        if (dst)
+        {
+            rv = aaxBufferCreate(config, frames, tracks, AAX_FLOAT);
+            if (rv && (!aaxBufferSetSetup(rv, AAX_FREQUENCY, proc.info.freq) ||
+                       !aaxBufferSetData(rv, dst)))
+            {
+                aaxBufferDestroy(rv);
+                rv = NULL;
+            }
+            free(dst);
+        }
+    }
+    processDestroy(&proc, stats);
+    aaxBufferDestroy(buffer);
+
+    return rv;
+}
+
+/*
+ * EBU R128 loudness normalization of the (processed) audio of a buffer.
+ * The decoded audio is kept in memory between the analysis and the gain
+ * pass so the input is decoded only once. With one thread the audio is
+ * measured by a single state. Otherwise long files are analysed in one
+ * segment per thread, at least LOUDNESS_SEGMENT_SEC long, and the gating
+ * blocks of all segments are combined into the integrated loudness. Every
+ * segment restarts the filters and the gating blocks which span the
+ * boundary between two segments are missing. The gain is limited so the
+ * true peak stays below the ceiling, there is no limiter so the target
+ * loudness is not reached for material with a high peak to loudness ratio.
+ */
+#define LOUDNESS_SEGMENT_SEC	30
+
+typedef struct
+{
+    const float *data;
+    unsigned int tracks;
+    unsigned int freq;
+    size_t no_samples;
+    size_t segment;		/* frames per segment */
+    ebur128_state **states;
+} _cvt_loudness_t;
+
+static void
+_loudnessJob(void *user, unsigned int n, unsigned int worker)
+{
+    _cvt_loudness_t *l = (_cvt_loudness_t*)user;
+    size_t pos = (size_t)n*l->segment;
+    size_t len = _MIN(l->segment, l->no_samples-pos);
+    ebur128_state *st;
+
+    st = ebur128_init(l->tracks, l->freq,
+                      EBUR128_MODE_I|EBUR128_MODE_TRUE_PEAK);
+    if (st && ebur128_add_frames_float(st, l->data+pos*l->tracks, len)) {
+        ebur128_destroy(&st);
+    }
+    l->states[n] = st;
+}
+
+/*
+ * Get the integrated loudness in LUFS and the true peak in dBTP.
+ * Returns AAX_FALSE on error.
+ */
+static int
+getLoudness(const float *data, size_t no_samples, unsigned int tracks,
+            unsigned int freq, unsigned int threads, double *loudness,
+            double *peak)
+{
+    unsigned int i, t, num;
+    _cvt_loudness_t l;
+    int rv = AAX_FALSE;
+
+    l.data = data;
+    l.tracks = tracks;
+    l.freq = freq;
+    l.no_samples = no_samples;
+    if (!threads) threads = _aaxGetNoCores();
+    l.segment = (size_t)LOUDNESS_SEGMENT_SEC*freq;
+    if (threads <= 1) l.segment = _MAX(no_samples, 1);
+    else l.segment = _MAX(l.segment, (no_samples + threads-1)/threads);
+    num = (no_samples + l.segment-1)/l.segment;
+    if (!num) num = 1;
+
+    l.states = calloc(num, sizeof(ebur128_state*));
+    if (!l.states) return rv;
+
+    _aaxParallelFor(threads, num, _loudnessJob, &l);
+
+    for (i=0; i<num; ++i) {
+        if (!l.states[i]) break;
+    }
+    if (i == num && ebur128_loudness_global_multiple(l.states, num,
+                                                     loudness) == 0)
+    {
+        double max = 0.0;
+
+        rv = AAX_TRUE;
+        for (i=0; i<num && rv; ++i)
+        {
+            for (t=0; t<tracks; ++t)
+            {
+                double tp;
+
+                if (ebur128_true_peak(l.states[i], t, &tp) != 0) {
+                    rv = AAX_FALSE;
+                }
+                else if (tp > max) max = tp;
+            }
+        }
+        *peak = (max > 0.0) ? 20.0*log10(max) : -HUGE_VAL;
+    }
+
+    for (i=0; i<num; ++i) {
+        if (l.states[i]) ebur128_destroy(&l.states[i]);
+    }
+    free(l.states);
+
+    return rv;
+}
+
+/*
+ * Returns a new buffer with the normalized audio or NULL on error.
+ * The buffer is destroyed.
+ */
+static aaxBuffer
+normalizeBuffer(aaxConfig config, aaxBuffer buffer,
+                const struct cvtopts_t *opts, struct cvtstats_t *stats)
+{
+    unsigned int tracks, freq, no_samples;
+    aaxBuffer rv = NULL;
+    void **data = NULL;
+
+    tracks = aaxBufferGetSetup(buffer, AAX_TRACKS);
+    freq = aaxBufferGetSetup(buffer, AAX_FREQUENCY);
+    no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+    if (aaxBufferSetSetup(buffer, AAX_FORMAT, AAX_FLOAT)) {
+        data = aaxBufferGetData(buffer);
+    }
+
+    if (data)
+    {
+        float *ptr = (float*)*data;
+        double loudness, peak;
+
+        if (getLoudness(ptr, no_samples, tracks, freq, opts->threads,
+                        &loudness, &peak))
+        {
+            double gain = 0.0, shortfall = 0.0;
+            size_t i, num;
+            float g;
+
+            /* leave silence alone */
+            if (loudness > -HUGE_VAL)
+            {
+                gain = opts->loudness - loudness;
+                if (peak + gain > opts->ceiling)
+                {
+                    shortfall = peak + gain - opts->ceiling;
+                    gain = opts->ceiling - peak;
+                }
+            }
+
+            g = (float)pow(10.0, gain/20.0);
+            num = (size_t)no_samples*tracks;
+            for (i=0; i<num; ++i) {
+                ptr[i] *= g;
+            }
+
+            rv = aaxBufferCreate(config, no_samples, tracks, AAX_FLOAT);
+            if (rv && (!aaxBufferSetSetup(rv, AAX_FREQUENCY, freq) ||
+                       !aaxBufferSetData(rv, ptr)))
+            {
+                aaxBufferDestroy(rv);
+                rv = NULL;
+            }
+
+            if (stats)
+            {
+                stats->loudness = loudness;
+                stats->peak = peak;
+                stats->gain = gain;
+                stats->shortfall = shortfall;
+                stats->normalized = AAX_TRUE;
+            }
+        }
+        else {
+            printf("Unable to measure the loudness\n");
+        }
+        aaxFree(data);
+    }
+    aaxBufferDestroy(buffer);
+
+    return rv;
+}
+
+/*
+ * Dither the audio of a buffer when it has a higher resolution than the
+ * output format. Returns a new buffer with the dithered audio, the buffer
+ * itself if there is nothing to do or NULL on error. The buffer is
+ * destroyed if it is replaced.
+ */
+static aaxBuffer
+ditherBuffer(aaxConfig config, aaxBuffer buffer, enum aaxFormat format,
+             enum _aaxDitherShape shape)
+{
+    unsigned int tracks, no_samples, bits;
+    _aaxDither *dither = NULL;
+    aaxBuffer rv = NULL;
+    void **data = NULL;
+    void *dithered;
+
+    bits = getDitherBits(aaxBufferGetSetup(buffer, AAX_FORMAT), format);
+    if (!bits || shape == AAX_DITHER_OFF) return buffer;
+
+    tracks = aaxBufferGetSetup(buffer, AAX_TRACKS);
+    no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+    dither = _aaxDitherCreate(tracks, bits, shape, 0);
+    if (dither && aaxBufferSetSetup(buffer, AAX_FORMAT, AAX_FLOAT)) {
+        data = aaxBufferGetData(buffer);
+    }
+
+    if (data)
+    {
+        dithered = ditherData(dither, *data, no_samples, tracks, bits,
+                              &format);
+        if (dithered)
+        {
+            rv = aaxBufferCreate(config, no_samples, tracks, format);
+            if (rv && (!aaxBufferSetSetup(rv, AAX_FREQUENCY,
+                                   aaxBufferGetSetup(buffer, AAX_FREQUENCY)) ||
+                       !aaxBufferSetData(rv, dithered)))
+            {
+                aaxBufferDestroy(rv);
+                rv = NULL;
+            }
+            free(dithered);
+        }
+        aaxFree(data);
+    }
+    _aaxDitherDestroy(dither);
+    aaxBufferDestroy(buffer);
+
+    return rv;
+}
+
+/*
+ * Write a buffer to an output, the buffer is destroyed.
+ */
+static int
+writeBuffer(aaxConfig config, aaxBuffer buffer,
+            const struct cvtout_t *output, enum _aaxDitherShape dither)
+{
+    int rv = AAX_FALSE;
+
+    buffer = ditherBuffer(config, buffer, output->format, dither);
+    if (!buffer) return rv;
+
+    aaxBufferSetSetup(buffer, AAX_FORMAT, output->format);
+    if (!output->raw) {
+        rv = aaxBufferWriteToFile(buffer, output->file, AAX_OVERWRITE);
+    } else {
+        rv = writeRawFile(buffer, output->file, output->format);
+    }
+    aaxBufferDestroy(buffer);
+
+    return rv;
+}
+
+/*
+ * Write the decoded audio to more than one output in parallel, every
+ * worker thread converts a copy of the audio using its own loopback
+ * configuration.
+ */
+typedef struct
+{
+    const struct cvtout_t *outputs;
+    aaxConfig *configs;
+    void **data;		/* the decoded audio, shared read-only */
+    enum aaxFormat format;
+    unsigned int no_samples;
+    unsigned int tracks;
+    unsigned int freq;
+    enum _aaxDitherShape dither;
+    int *results;
+} _cvt_encode_t;
+
+static void
+_encodeJob(void *user, unsigned int n, unsigned int worker)
+{
+    _cvt_encode_t *enc = (_cvt_encode_t*)user;
+    aaxConfig config = enc->configs[worker];
+    aaxBuffer buffer = NULL;
+
+    if (!config)
+    {
+        config = aaxDriverOpenByName("AeonWave Loopback",
+                                     AAX_MODE_WRITE_STEREO);
+        enc->configs[worker] = config;
+    }
+
+    if (config) {
+        buffer = aaxBufferCreate(config, enc->no_samples, enc->tracks,
+                                 enc->format);
+    }
+    if (buffer)
+    {
+        if (aaxBufferSetSetup(buffer, AAX_FREQUENCY, enc->freq) &&
+            aaxBufferSetData(buffer, *enc->data))
+        {
+            enc->results[n] = writeBuffer(config, buffer, &enc->outputs[n],
+                                          enc->dither);
+        }
+        else {
+            aaxBufferDestroy(buffer);
+        }
+    }
+}
+
+static int
+writeBufferOutputs(aaxConfig config, aaxBuffer buffer,
+                   const struct cvtout_t *outputs, unsigned int num,
+                   enum _aaxDitherShape dither)
+{
+    aaxConfig configs[MAX_OUTPUTS];
+    int results[MAX_OUTPUTS];
+    _cvt_encode_t enc;
+    unsigned int i, threads;
+    int rv = AAX_FALSE;
+
+    memset(&enc, 0, sizeof(enc));
+    memset(configs, 0, sizeof(configs));
+    memset(results, 0, sizeof(results));
+
+    enc.outputs = outputs;
+    enc.configs = configs;
+    enc.results = results;
+    enc.format = aaxBufferGetSetup(buffer, AAX_FORMAT);
+    enc.no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+    enc.tracks = aaxBufferGetSetup(buffer, AAX_TRACKS);
+    enc.freq = aaxBufferGetSetup(buffer, AAX_FREQUENCY);
+    enc.dither = dither;
+    enc.data = aaxBufferGetData(buffer);
+    if (enc.data)
+    {
+        /* the calling thread is worker 0 */
+        configs[0] = config;
+        threads = _aaxParallelFor(0, num, _encodeJob, &enc);
+        for (i=1; i<threads; ++i) {
+            if (configs[i]) aaxDriverDestroy(configs[i]);
+        }
+        aaxFree(enc.data);
+
+        rv = AAX_TRUE;
+        for (i=0; i<num; ++i) {
+            if (!results[i]) rv = AAX_FALSE;
+        }
+    }
+    return rv;
+}
+
+/*
+ * Keep only a range of the samples of a buffer, for files which could not
+ * be read partially. Returns a new buffer with the range, the buffer
+ * itself if there is nothing to do or NULL on error. The buffer is
+ * destroyed if it is replaced.
+ */
+static aaxBuffer
+trimBuffer(aaxConfig config, aaxBuffer buffer, const struct cvtopts_t *opts)
+{
+    unsigned int tracks, freq, no_samples, bps;
+    uint64_t start, length;
+    enum aaxFormat format;
+    aaxBuffer rv = NULL;
+    void **data = NULL;
+
+    freq = aaxBufferGetSetup(buffer, AAX_FREQUENCY);
+    no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+    if (!getRange(opts, freq, &start, &length)) return buffer;
+
+    start = _MIN(start, no_samples);
+    if (!length || length > no_samples-start) length = no_samples-start;
+
+    /* block based formats can not be cut at every sample */
+    format = aaxBufferGetSetup(buffer, AAX_FORMAT);
+    if (format == AAX_IMA4_ADPCM) format = AAX_PCM16S;
+
+    tracks = aaxBufferGetSetup(buffer, AAX_TRACKS);
+    bps = aaxGetBitsPerSample(format)/8;
+    if (length && aaxBufferSetSetup(buffer, AAX_FORMAT, format)) {
+        data = aaxBufferGetData(buffer);
+    }
+
+    if (data)
+    {
+        const char *ptr = (const char*)*data + start*tracks*bps;
+
+        rv = aaxBufferCreate(config, length, tracks, format);
+        if (rv && (!aaxBufferSetSetup(rv, AAX_FREQUENCY, freq) ||
+                   !aaxBufferSetData(rv, (void*)ptr)))
+        {
+            aaxBufferDestroy(rv);
+            rv = NULL;
+        }
+        aaxFree(data);
+    }
+    aaxBufferDestroy(buffer);
+
+    return rv;
+}
+
+/*
+ * Conversion of the file as a whole, for files which the library has to
+ * decode and for formats which need the complete file at once. The file is
+ * decoded only once, also when it is written to more than one output.
+ */
+static int
+convertBuffer(aaxConfig config, const char *infile,
+              const struct cvtout_t *outputs, unsigned int num,
+              const struct cvtopts_t *opts, struct cvtstats_t *stats)
+{
+    aaxBuffer buffer = NULL;
+    struct wavinfo_t info;
+    int rv = AAX_FALSE;
+
+    /* read only the requested range of WAVE files */
+    if ((opts->start || opts->duration) &&
+        fileProbe(infile, &info, NULL) == 0)
+    {
+        uint64_t start, length;
+
+        getRange(opts, info.freq, &start, &length);
+        buffer = bufferFromFileRange(config, infile, start, length);
+        if (buffer && stats)
+        {
+            wavInfoSetRange(&info, start, length);
+            stats->bytes = info.data_size;
+        }
+    }
+    if (!buffer)
+    {
+        buffer = bufferFromFile(config, infile);
+        if (buffer && (opts->start || opts->duration)) {
+            buffer = trimBuffer(config, buffer, opts);
+        }
+    }
+
+    if (buffer)
+    {
+        if (stats)
+        {
+            float freq = aaxBufferGetSetup(buffer, AAX_FREQUENCY);
+            unsigned int no_samples;
+
+            no_samples = aaxBufferGetSetup(buffer, AAX_NO_SAMPLES);
+            stats->duration = (freq > 0.0f) ? no_samples/freq : 0.0;
+        }
+        buffer = processBuffer(config, buffer, opts, stats);
+        if (buffer && opts->normalize) {
+            buffer = normalizeBuffer(config, buffer, opts, stats);
+        }
+    }
+
+    if (buffer)
+    {
+        if (num == 1) {
+            rv = writeBuffer(config, buffer, &outputs[0], opts->dither);
+        }
+        else
+        {
+            rv = writeBufferOutputs(config, buffer, outputs, num,
+                                    opts->dither);
+            aaxBufferDestroy(buffer);
+        }
+    }
+    return rv;
+}
+
+/**
+ * Convert a single file using an already opened loopback configuration.
+ * WAVE files are converted in fixed size blocks whenever possible.
+ * The input is decoded once and written to every output in its own format.
+ *
+ * @param config the loopback configuration to create the buffer for
+ * @param infile the audio file to convert
+ * @param outputs the files to write the converted audio to and their format
+ * @param num the number of outputs
+ * @param opts the processing to apply and whether to use a pipeline
+ * @param stats if not NULL, receives the size, duration and conversion time
+ *
+ * Returns AAX_TRUE on success or AAX_FALSE otherwise.
+ */
+static int
+convertFile(aaxConfig config, const char *infile,
+            const struct cvtout_t *outputs, unsigned int num,
+            const struct cvtopts_t *opts, struct cvtstats_t *stats)
+{
+    _aaxTimer *timer = stats ? _aaxTimerCreate() : NULL;
+    int rv = -1;
+
+    if (stats) memset(stats, 0, sizeof(struct cvtstats_t));
+    if (timer) _aaxTimerStart(timer);
+
+    /* normalization needs all of the audio before writing it */
+#if !NO_THREADS
+    if (opts->pipeline && !opts->normalize) {
+        rv = convertPipeline(config, infile, outputs, num, opts, stats);
+    }
+#endif
+    if (rv < 0 && !opts->normalize) {
+        rv = convertStream(config, infile, outputs, num, opts, stats);
+    }
+    if (rv < 0) {
+        rv = convertBuffer(config, infile, outputs, num, opts, stats);
+    }
+
+    if (stats)
+    {
+        struct stat st;
+
+        /* the size of the range, if only part of the file was read */
+        if (!stats->bytes) {
+            stats->bytes = (stat(infile, &st) == 0) ? st.st_size : 0;
+        }
+        stats->elapsed = timer ? _aaxTimerElapsed(timer) : 0.0;
+        stats->files = 1;
+        stats->failed = rv ? 0 : 1;
+    }
+    _aaxTimerDestroy(timer);
+
+    return rv;
+}
+
+static void
+printShortfall(const struct cvtstats_t *stats)
+{
+    if (stats->shortfall > 0.0)
+    {
+        printf("Warning: gain limited by the true peak ceiling, the "
+               "result is %.1f dB below the target loudness\n",
+               stats->shortfall);
+    }
+}
+
+static void
+printStats(const char *name, const struct cvtstats_t *stats)
+{
+    double mb = stats->bytes/(1024.0*1024.0);
+    double elapsed = _MAX(stats->elapsed, 1e-6);
+
+    printf("%s: %.1f MB, %.1f sec. audio in %.3f sec. "
+           "(%.1f MB/s, %.0fx realtime)\n", name, mb, stats->duration,
+           stats->elapsed, mb/elapsed, stats->duration/elapsed);
+    if (stats->process > 0.0)
+    {
+        printf("Resampling %u Hz to %u Hz: %.3f sec. (%.0fx realtime)\n",
+               stats->freq[0], stats->freq[1], stats->process,
+               stats->duration/stats->process);
+    }
+    if (stats->remix > 0.0)
+    {
+        printf("Remixing %u to %u tracks: %.3f sec. (%.0fx realtime)\n",
+               stats->tracks[0], stats->tracks[1], stats->remix,
+               stats->duration/stats->remix);
+    }
+    if (stats->normalized)
+    {
+        printf("Loudness %.1f LUFS, true peak %.1f dBTP, gain %+.1f dB\n",
+               stats->loudness, stats->peak, stats->gain);
+        printShortfall(stats);
+    }
+}
+
+/*
+ * Collect the input files for (batch) conversion and the matching output
+ * file names from the output template.
+ */
+typedef struct
+{
+    char **infiles;
+    char **outfiles;
+    unsigned int num, max;
+    int batch;
+} _cvt_list_t;
+
+static int
+makeDirectories(const char *file)
+{
+    char path[4096], *ptr;
+
+    snprintf(path, sizeof(path), "%s", file);
+    for (ptr = path+1; *ptr; ++ptr)
+    {
+        if (*ptr == '/' || *ptr == '\\')
+        {
+            char c = *ptr;
+
+            *ptr = 0;
+            if (mkdir(path, 0755) < 0 && errno != EEXIST) return AAX_FALSE;
+            *ptr = c;
+        }
+    }
+    return AAX_TRUE;
+}
+
+/*
+ * Expand the output template for one input file.
+ * root is the searched directory which the input file is part of, or NULL.
+ */
+static char *
+getOutputName(const char *tmpl, const char *root, const char *infile)
+{
+    const char *name, *rel, *dot, *src;
+    size_t dlen = 0, nlen, flen;
+    char *rv, *dst, *end;
+
+    name = strrchr(infile, '/');
+    if (!name) name = strrchr(infile, '\\');
+    name = name ? name+1 : infile;
+
+    rel = infile;
+    if (root)
+    {
+        size_t rlen = strlen(root);
+        if (!strncmp(infile, root, rlen) && infile[rlen] == '/') {
+            rel = infile+rlen+1;
+        }
+        if (name > rel) dlen = name-rel-1;
+    }
+
+    flen = strlen(name);
+    dot = strrchr(name, '.');
+    nlen = dot ? (size_t)(dot-name) : flen;
+
+    rv = malloc(4096);
+    if (!rv) return NULL;
+
+    dst = rv;
+    end = rv+4095;
+    for (src = tmpl; *src && dst < end; ++src)
+    {
+        const char *s = NULL;
+        size_t len = 0;
+
+        if (*src != '%' || !*(src+1))
+        {
+            *dst++ = *src;
+            continue;
+        }
+
+        switch (*++src)
+        {
+        case 'n':
+            s = name;
+            len = nlen;
+            break;
+        case 'f':
+            s = name;
+            len = flen;
+            break;
+        case 'd':
+            s = rel;
+            len = dlen;
+            if (!len && (*(src+1) == '/' || *(src+1) == '\\')) src++;
+            break;
+        default:
+            *dst++ = *src;
+            break;
+        }
+        if (len > (size_t)(end-dst)) len = end-dst;
+        if (s) memcpy(dst, s, len);
+        dst += len;
+    }
+    *dst = 0;
+
+    return rv;
+}
+
+static int
+addFiles(_cvt_list_t *list, const char *path, const char *tmpl)
+{
+    unsigned int i, num;
+    char **files;
+    int dir;
+
+    files = getFileList(path, BATCH_EXTENSIONS, &num);
+    if (!files)
+    {
+        /* a directory without any matching files */
+        list->batch = AAX_TRUE;
+        return AAX_TRUE;
+    }
+
+    /* a path which is not a directory is returned as the only entry */
+    dir = (num != 1 || strcmp(files[0], path));
+    if (dir) list->batch = AAX_TRUE;
+
+    if (list->num+num > list->max)
+    {
+        unsigned int max = list->num+num+16;
+        char **infiles, **outfiles;
+
+        infiles = realloc(list->infiles, max*sizeof(char*));
+        if (infiles) list->infiles = infiles;
+        outfiles = realloc(list->outfiles, max*sizeof(char*));
+        if (outfiles) list->outfiles = outfiles;
+        if (!infiles || !outfiles)
+        {
+            freeFileList(files, num);
+            return AAX_FALSE;
+        }
+        list->max = max;
+    }
+
+    for (i=0; i<num; ++i)
+    {
+        char *outfile = NULL;
+
+        if (tmpl) outfile = getOutputName(tmpl, dir ? path : NULL, files[i]);
+        list->infiles[list->num] = files[i];
+        list->outfiles[list->num] = outfile;
+        list->num++;
+    }
+    free(files);
+
+    return AAX_TRUE;
+}
+
+static void
+freeInputList(_cvt_list_t *list)
+{
+    unsigned int i;
+
+    for (i=0; i<list->num; ++i) {
+        free(list->outfiles[i]);
+    }
+    free(list->outfiles);
+    freeFileList(list->infiles, list->num);
+}
+
+/*
+ * Get all -i or --input arguments, expand directories and wildcard
+ * patterns and determine whether batch mode should be used.
+ */
+static int
+getInputList(int argc, char **argv, const char *tmpl, _cvt_list_t *list)
+{
+    unsigned int inputs = 0;
+    int i, rv = AAX_TRUE;
+
+    memset(list, 0, sizeof(_cvt_list_t));
+    for (i=1; i<argc && rv; i++)
+    {
+        char *path = NULL;
+
+        if (!strcmp(argv[i], "-i") || !strcmp(argv[i], "--input")) {
+            if (i+1 < argc) path = argv[++i];
+        }
+        else if (!strncmp(argv[i], "--input=", strlen("--input="))) {
+            path = argv[i]+strlen("--input=");
+        }
+        else if (!strncmp(argv[i], "-i=", strlen("-i="))) {
+            path = argv[i]+strlen("-i=");
+        }
+        if (!path) continue;
+
+        inputs++;
+#if HAVE_GLOB_H
+        if (strpbrk(path, "*?["))
+        {
+            glob_t g;
+
+            list->batch = AAX_TRUE;
+            if (glob(path, 0, NULL, &g) == 0)
+            {
+                size_t n;
+                for (n=0; n<g.gl_pathc && rv; ++n) {
+                    rv = addFiles(list, g.gl_pathv[n], tmpl);
+                }
+                globfree(&g);
+            }
+            continue;
+        }
+#endif
+        rv = addFiles(list, path, tmpl);
+    }
+    if (inputs > 1) list->batch = AAX_TRUE;
+
+    return rv;
+}
+
+/*
+ * Get all -o or --output arguments. An output may be followed by a colon
+ * and the format to write it in and by :raw to write it without a file
+ * header, e.g. out.pcm:AAX_FLOAT:raw. Returns the number of outputs.
+ */
+static unsigned int
+getOutputList(int argc, char **argv, const struct cvtopts_t *opts,
+              struct cvtout_t *outputs)
+{
+    unsigned int num = 0;
+    int i;
+
+    for (i=1; i<argc; i++)
+    {
+        struct cvtout_t *out;
+        char *path = NULL;
+        char *ptr;
+
+        if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
+            if (i+1 < argc) path = argv[++i];
+        }
+        else if (!strncmp(argv[i], "--output=", strlen("--output="))) {
+            path = argv[i]+strlen("--output=");
+        }
+        else if (!strncmp(argv[i], "-o=", strlen("-o="))) {
+            path = argv[i]+strlen("-o=");
+        }
+        if (!path) continue;
+
+        if (num == MAX_OUTPUTS)
+        {
+            printf("Too many outputs, only the first %i are used.\n",
+                   MAX_OUTPUTS);
+            break;
+        }
+
+        out = &outputs[num];
+        out->file = strDup(path);
+        if (!out->file) break;
+
+        out->format = opts->format;
+        out->raw = opts->raw;
+        while ((ptr = strrchr(out->file, ':')) != NULL)
+        {
+            enum aaxFormat format;
+
+            format = getFormatFromString(ptr+1, AAX_FORMAT_NONE);
+            if (!strcasecmp(ptr+1, "raw")) out->raw = AAX_TRUE;
+            else if (format != AAX_FORMAT_NONE) out->format = format;
+            else break;
+            *ptr = 0;
+        }
+        if (out->format == AAX_AAXS16S) out->raw = AAX_TRUE;
+        num++;
+    }
+    return num;
+}
+
+/*
+ * Incremental batch conversion: the manifest holds the hash of the source
+ * file, of the conversion options and of the output file for every output
+ * file. A file is only converted again when one of them has changed.
+ * Files are hashed in large blocks with MurmurHash3, the hash of every
+ * block is chained into the hash of the file.
+ */
+#define HASH_BLOCK_SIZE		(1024*1024)
+#define HASH_SEED		0x61617863
+
+typedef struct
+{
+    uint64_t h[2];
+} _cvt_hash_t;
+
+static void
+hashUpdate(_cvt_hash_t *hash, const void *data, size_t len)
+{
+    uint64_t chain[4];
+
+    MurmurHash3_x64_128(data, (int)len, HASH_SEED, &chain[2]);
+    chain[0] = hash->h[0];
+    chain[1] = hash->h[1];
+    MurmurHash3_x64_128(chain, sizeof(chain), HASH_SEED, hash->h);
+}
+
+static int
+hashFile(const char *file, _cvt_hash_t *hash)
+{
+    int fd, rv = AAX_FALSE;
+    char *buf;
+
+    memset(hash, 0, sizeof(_cvt_hash_t));
+    fd = open(file, O_RDONLY|O_BINARY);
+    if (fd < 0) return rv;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    buf = malloc(HASH_BLOCK_SIZE);
+    if (buf)
+    {
+        ssize_t len;
+
+        while ((len = read(fd, buf, HASH_BLOCK_SIZE)) > 0) {
+            hashUpdate(hash, buf, len);
+        }
+        rv = (len == 0);
+        free(buf);
+    }
+    close(fd);
+
+    return rv;
+}
+
+/* everything which changes the output of a conversion */
+static void
+hashOptions(const struct cvtopts_t *opts, int playfs, _cvt_hash_t *hash)
+{
+    char str[128];
+
+    snprintf(str, sizeof(str),
+             "aaxcvt %i.%i.%i %x %i %u %i %i %i %g %g %g %g",
+             AAX_UTILS_MAJOR_VERSION, AAX_UTILS_MINOR_VERSION,
+             AAX_UTILS_MICRO_VERSION, opts->format, opts->raw, opts->freq,
+             opts->quality, opts->dither, playfs,
+             opts->normalize ? opts->loudness : 0.0,
+             opts->normalize ? opts->ceiling : 0.0,
+             opts->start, opts->duration);
+    memset(hash, 0, sizeof(_cvt_hash_t));
+    hashUpdate(hash, str, strlen(str));
+    if (opts->remix) hashUpdate(hash, opts->remix, strlen(opts->remix));
+}
+
+typedef struct
+{
+    char *outfile;
+    _cvt_hash_t src;
+    _cvt_hash_t opts;
+    _cvt_hash_t out;
+    int valid;			/* the hashes are set */
+    int used;			/* replaced by the current batch */
+} _cvt_manifest_entry_t;
+
+typedef struct
+{
+    _cvt_manifest_entry_t *entries;	/* sorted by output file name */
+    unsigned int num;
+} _cvt_manifest_t;
+
+static int
+compareEntries(const void *a, const void *b)
+{
+    const _cvt_manifest_entry_t *ea = (const _cvt_manifest_entry_t*)a;
+    const _cvt_manifest_entry_t *eb = (const _cvt_manifest_entry_t*)b;
+    return strcmp(ea->outfile, eb->outfile);
+}
+
+static _cvt_manifest_entry_t *
+manifestFind(_cvt_manifest_t *manifest, const char *outfile)
+{
+    _cvt_manifest_entry_t key;
+
+    if (!manifest->num) return NULL;
+
+    key.outfile = (char*)outfile;
+    return bsearch(&key, manifest->entries, manifest->num,
+                   sizeof(_cvt_manifest_entry_t), compareEntries);
+}
+
+static int
+parseHash(const char *s, _cvt_hash_t *hash)
+{
+    return (sscanf(s, "%16" SCNx64 "%16" SCNx64, &hash->h[0], &hash->h[1]) == 2);
+}
+
+/*
+ * Every line of the manifest holds the source, options and output hash
+ * followed by the output file name. A missing manifest is empty.
+ */
+static int
+manifestLoad(_cvt_manifest_t *manifest, const char *file)
+{
+    unsigned int max = 0;
+    char line[4096+128];
+    FILE *fp;
+
+    memset(manifest, 0, sizeof(_cvt_manifest_t));
+    fp = fopen(file, "r");
+    if (!fp) return (errno == ENOENT);
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        _cvt_manifest_entry_t *e;
+        char *ptr;
+
+        ptr = strpbrk(line, "\r\n");
+        if (ptr) *ptr = 0;
+        if (strlen(line) < 3*33+1) continue;
+
+        if (manifest->num == max)
+        {
+            max = max ? 2*max : 1024;
+            e = realloc(manifest->entries, max*sizeof(_cvt_manifest_entry_t));
+            if (!e) break;
+            manifest->entries = e;
+        }
+
+        e = &manifest->entries[manifest->num];
+        memset(e, 0, sizeof(_cvt_manifest_entry_t));
+        if (parseHash(line, &e->src) && parseHash(line+33, &e->opts) &&
+            parseHash(line+2*33, &e->out))
+        {
+            e->outfile = strDup(line+3*33);
+            e->valid = AAX_TRUE;
+            if (e->outfile) manifest->num++;
+        }
+    }
+    fclose(fp);
+
+    if (manifest->num) {
+        qsort(manifest->entries, manifest->num,
+              sizeof(_cvt_manifest_entry_t), compareEntries);
+    }
+    return AAX_TRUE;
+}
+
+static void
+writeEntry(FILE *fp, const char *outfile, const _cvt_manifest_entry_t *e)
+{
+    fprintf(fp, "%016" PRIx64 "%016" PRIx64 " %016" PRIx64 "%016" PRIx64
+                " %016" PRIx64 "%016" PRIx64 " %s\n",
+            e->src.h[0], e->src.h[1], e->opts.h[0], e->opts.h[1],
+            e->out.h[0], e->out.h[1], outfile);
+}
+
+/*
+ * Write the entries of the current batch and the entries of files which
+ * are not part of it. The manifest is replaced at once so it stays intact
+ * when writing fails.
+ */
+static int
+manifestSave(_cvt_manifest_t *manifest, const char *file,
+             const _cvt_list_t *list, const _cvt_manifest_entry_t *results)
+{
+    int rv = AAX_FALSE;
+    unsigned int i;
+    char tmp[4096];
+    FILE *fp;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", file);
+    fp = fopen(tmp, "w");
+    if (!fp) return rv;
+
+    for (i=0; i<list->num; ++i) {
+        if (results[i].valid) writeEntry(fp, list->outfiles[i], &results[i]);
+    }
+    for (i=0; i<manifest->num; ++i)
+    {
+        const _cvt_manifest_entry_t *e = &manifest->entries[i];
+        if (!e->used) writeEntry(fp, e->outfile, e);
+    }
+
+    rv = !ferror(fp);
+    if (fclose(fp) != 0) rv = AAX_FALSE;
+#ifdef _WIN32
+    if (rv) remove(file);
+#endif
+    if (rv && rename(tmp, file) != 0) rv = AAX_FALSE;
+    if (!rv)
+    {
+        printf("Unable to write the manifest: %s\n", file);
+        remove(tmp);
+    }
+    return rv;
+}
+
+static void
+manifestFree(_cvt_manifest_t *manifest)
+{
+    unsigned int i;
+
+    for (i=0; i<manifest->num; ++i) {
+        free(manifest->entries[i].outfile);
+    }
+    free(manifest->entries);
+}
+
+/*
+ * Batch conversion: every worker thread opens its own loopback
+ * configuration on first use and reuses it for all of its files.
+ */
+typedef struct
+{
+    _cvt_list_t *list;
+    aaxConfig *configs;
+    struct cvtopts_t opts;
+    int playfs;
+
+    _cvt_manifest_t *manifest;	/* NULL for a full conversion */
+    _cvt_manifest_entry_t *results;
+    _cvt_hash_t opts_hash;
+
+    _aaxMutex mutex;
+    struct cvtstats_t total;
+} _batch_cvt_t;
+
+static void
+_convertJob(void *user, unsigned int n, unsigned int worker)
+{
+    _batch_cvt_t *batch = (_batch_cvt_t*)user;
+    const char *infile = batch->list->infiles[n];
+    char *outfile = batch->list->outfiles[n];
+    aaxConfig config = batch->configs[worker];
+    struct cvtstats_t stats;
+    struct cvtout_t output;
+
+    memset(&stats, 0, sizeof(stats));
+    output.file = outfile;
+    output.format = batch->opts.format;
+    output.raw = batch->opts.raw;
+
+    if (batch->manifest && outfile)
+    {
+        _cvt_manifest_entry_t *result = &batch->results[n];
+        _cvt_manifest_entry_t *e;
+
+        e = manifestFind(batch->manifest, outfile);
+        if (e) e->used = AAX_TRUE;
+
+        result->opts = batch->opts_hash;
+        result->valid = hashFile(infile, &result->src);
+        if (result->valid && e &&
+            !memcmp(&e->src, &result->src, sizeof(_cvt_hash_t)) &&
+            !memcmp(&e->opts, &result->opts, sizeof(_cvt_hash_t)) &&
+            hashFile(outfile, &result->out) &&
+            !memcmp(&e->out, &result->out, sizeof(_cvt_hash_t)))
+        {
+            _aaxMutexLock(&batch->mutex);
+            batch->total.files++;
+            batch->total.skipped++;
+            _aaxMutexUnLock(&batch->mutex);
+            return;
+        }
+    }
+
+    if (!config)
+    {
+        config = aaxDriverOpenByName("AeonWave Loopback",
+                                     AAX_MODE_WRITE_STEREO);
+        if (config && batch->playfs) {
+            aaxMixerSetSetup(config, AAX_FREQUENCY, batch->playfs);
+        }
+        batch->configs[worker] = config;
+    }
+
+    if (!config || !outfile || !makeDirectories(outfile) ||
+        !convertFile(config, infile, &output, 1, &batch->opts, &stats))
+    {
+        stats.files = stats.failed = 1;
+    }
+
+    if (batch->manifest && outfile)
+    {
+        _cvt_manifest_entry_t *result = &batch->results[n];
+        if (stats.failed || !hashFile(outfile, &result->out)) {
+            result->valid = AAX_FALSE;
+        }
+    }
+
+    /* report under the mutex so the lines of the workers do not mix */
+    _aaxMutexLock(&batch->mutex);
+    if (stats.failed) {
+        printf("%s: conversion failed\n", infile);
+    } else {
+        printStats(outfile, &stats);
+    }
+    batch->total.files += stats.files;
+    batch->total.failed += stats.failed;
+    batch->total.bytes += stats.bytes;
+    batch->total.duration += stats.duration;
+    _aaxMutexUnLock(&batch->mutex);
+}
+
+/*
+ * Returns the number of failed conversions or -1 on error.
+ * If manifest is not NULL only files which have changed since the last
+ * conversion are converted and the manifest is updated afterwards.
+ */
+static int
+convertBatch(_cvt_list_t *list, unsigned int jobs,
+             const struct cvtopts_t *opts, int playfs, const char *manifest)
+{
+    _aaxTimer *timer = _aaxTimerCreate();
+    _cvt_manifest_t entries;
+    unsigned int i, threads;
+    _batch_cvt_t batch;
+
+    threads = jobs ? jobs : _aaxGetNoCores();
+    if (threads > list->num) threads = list->num;
+    if (!threads) threads = 1;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.list = list;
+    batch.opts = *opts;
+    batch.opts.pipeline = AAX_FALSE;
+    batch.opts.threads = 1;	/* the files are converted in parallel */
+    batch.playfs = playfs;
+    batch.configs = calloc(threads, sizeof(aaxConfig));
+    if (!batch.configs)
+    {
+        _aaxTimerDestroy(timer);
+        return -1;
+    }
+
+    if (manifest)
+    {
+        batch.results = calloc(list->num, sizeof(_cvt_manifest_entry_t));
+        if (!batch.results || !manifestLoad(&entries, manifest))
+        {
+            printf("Unable to read the manifest: %s\n", manifest);
+            free(batch.results);
+            free(batch.configs);
+            _aaxTimerDestroy(timer);
+            return -1;
+        }
+        batch.manifest = &entries;
+        hashOptions(&batch.opts, playfs, &batch.opts_hash);
+    }
+    _aaxMutexInit(&batch.mutex);
+
+    if (timer) _aaxTimerStart(timer);
+    threads = _aaxParallelFor(threads, list->num, _convertJob, &batch);
+    batch.total.elapsed = timer ? _aaxTimerElapsed(timer) : 0.0;
+
+    for (i=0; i<threads; ++i)
+    {
+        if (batch.configs[i]) aaxDriverDestroy(batch.configs[i]);
+    }
+    free(batch.configs);
+    _aaxMutexDestroy(&batch.mutex);
+    _aaxTimerDestroy(timer);
+
+    if (manifest)
+    {
+        manifestSave(&entries, manifest, list, batch.results);
+        manifestFree(&entries);
+        free(batch.results);
+    }
+
+    printf("\nConverted %u of %u files using %u thread%s",
+           batch.total.files - batch.total.failed - batch.total.skipped,
+           batch.total.files, threads, (threads == 1) ? "" : "s");
+    if (manifest) printf(", %u unchanged", batch.total.skipped);
+    printf("\n");
+    printStats("Total", &batch.total);
+
+    return batch.total.failed;
+}
+
+int main(int argc, char **argv)
+{
+    struct cvtout_t outputs[MAX_OUTPUTS];
+    unsigned int i, num_outputs;
+    struct cvtopts_t opts;
+    char *outfile, *tmpl, *s;
+    _cvt_list_t files;
+    int rv = 0;
+
+    if (argc == 1 || getCommandLineOption(argc, argv, "-h") ||
+        getCommandLineOption(argc, argv, "--help"))
+    {
+        help();
+    }
+
+    if (getCommandLineOption(argc, argv, "-l") ||
+        getCommandLineOption(argc, argv, "--list"))
+    {
+       list();
+    }
+
+    memset(&opts, 0, sizeof(opts));
+    opts.raw = (getCommandLineOption(argc, argv, "-r") ||
+                getCommandLineOption(argc, argv, "--raw")) ? 1 : 0;
+
+    opts.format = getAudioFormat(argc, argv, AAX_FORMAT_NONE);
+    if (opts.format == AAX_AAXS16S) opts.raw = AAX_TRUE;
+    if (opts.format == AAX_FORMAT_NONE)
+    {
+        printf("Unsupported audio format.\n");
+        return -2;
+    }
+
+    num_outputs = getOutputList(argc, argv, &opts, outputs);
+    if (!num_outputs) {
+       help();
+    }
+    outfile = outputs[0].file;
+
+    s = getCommandLineOption(argc, argv, "-s");
+    if (!s) s = getCommandLineOption(argc, argv, "--samplerate");
+    if (s)
+    {
+        int freq = atoi(s);
+        if (freq < 1000 || freq > 768000)
+        {
+            printf("Unsupported sample rate: %s\n", s);
+            return -2;
+        }
+        opts.freq = freq;
+    }
+
+    opts.quality = AAX_RESAMPLE_HIGH;
+    s = getCommandLineOption(argc, argv, "-q");
+    if (!s) s = getCommandLineOption(argc, argv, "--quality");
+    if (s)
+    {
+        int quality = _aaxResampleGetQuality(s);
+        if (quality < 0)
+        {
+            printf("Unsupported resampling quality: %s\n", s);
+            return -2;
+        }
+        opts.quality = quality;
+    }
+
+    opts.dither = AAX_DITHER_TPDF;
+    s = getCommandLineOption(argc, argv, "-d");
+    if (!s) s = getCommandLineOption(argc, argv, "--dither");
+    if (s)
+    {
+        int dither = _aaxDitherGetShape(s);
+        if (dither < 0)
+        {
+            printf("Unsupported dither: %s\n", s);
+            return -2;
+        }
+        opts.dither = dither;
+    }
+
+    s = getCommandLineOption(argc, argv, "-n");
+    if (!s) s = getCommandLineOption(argc, argv, "--normalize");
+    if (s)
+    {
+        opts.normalize = AAX_TRUE;
+        opts.loudness = atof(s);
+        if (opts.loudness >= 0.0 || opts.loudness < -70.0)
+        {
+            printf("Unsupported loudness: %s LUFS\n", s);
+            return -2;
+        }
+    }
+
+    opts.ceiling = -1.0;
+    s = getCommandLineOption(argc, argv, "-t");
+    if (!s) s = getCommandLineOption(argc, argv, "--true-peak");
+    if (s) opts.ceiling = _MIN(atof(s), 0.0);
+
+    s = getCommandLineOption(argc, argv, "-c");
+    if (!s) s = getCommandLineOption(argc, argv, "--channels");
+    if (s && *s) opts.remix = s;
+
+    s = getCommandLineOption(argc, argv, "--start");
+    if (s) opts.start = _MAX(atof(s), 0.0);
+
+    s = getCommandLineOption(argc, argv, "--duration");
+    if (s)
+    {
+        opts.duration = atof(s);
+        if (opts.duration <= 0.0)
+        {
+            printf("Unsupported duration: %s seconds\n", s);
+            return -2;
+        }
+    }
+
+    /* an output without a placeholder in batch mode is a directory */
+    tmpl = NULL;
+    if (strchr(outfile, '%')) {
+        tmpl = strDup(outfile);
+    }
+    else
+    {
+        size_t len = strlen(outfile) + strlen("/%d/%n.wav") + 1;
+        tmpl = malloc(len);
+        if (tmpl) {
+            snprintf(tmpl, len, "%s/%%d/%%n.%s", outfile,
+                     outputs[0].raw ? "raw" : "wav");
+        }
+    }
+
+    if (!getInputList(argc, argv, tmpl, &files) ||
+        (!files.num && !files.batch))
+    {
+        printf("Input file not specified or unable to access.\n");
+        freeInputList(&files);
+        free(tmpl);
+        help();
+    }
+
+    if (files.batch && num_outputs > 1)
+    {
+        printf("Only one output can be specified in batch mode.\n");
+        rv = -2;
+    }
+    else if (files.batch)
+    {
+        char *jobs = getCommandLineOption(argc, argv, "-j");
+        char *rfs = getCommandLineOption(argc, argv, "-p");
+        char *manifest = getCommandLineOption(argc, argv, "-m");
+
+        if (!jobs) jobs = getCommandLineOption(argc, argv, "--jobs");
+        if (!rfs) rfs = getCommandLineOption(argc, argv, "--playfs");
+        if (!manifest) manifest = getCommandLineOption(argc, argv,
+                                                       "--manifest");
+
+        opts.format = outputs[0].format;
+        opts.raw = outputs[0].raw;
+        if (convertBatch(&files, jobs ? atoi(jobs) : 0, &opts,
+                         rfs ? atoi(rfs) : 0, manifest)) {
+            rv = -3;
+        }
+    }
+    else
+    {
+        char *rfs = getCommandLineOption(argc, argv, "-p");
+        struct cvtstats_t stats;
+        aaxConfig config;
+        int verbose;
+
+        if (!rfs) rfs = getCommandLineOption(argc, argv, "--playfs");
+        verbose = (getCommandLineOption(argc, argv, "-v") ||
+                   getCommandLineOption(argc, argv, "--verbose"));
+
+        config=aaxDriverOpenByName("AeonWave Loopback", AAX_MODE_WRITE_STEREO);
+        if (rfs) {
+            aaxMixerSetSetup(config, AAX_FREQUENCY, atoi(rfs));
+         }
+
+        opts.pipeline = AAX_TRUE;
+        if (!convertFile(config, files.infiles[0], outputs, num_outputs,
+                         &opts, &stats)) {
+            rv = -3;
+        }
+        else if (verbose)
+        {
+            printStats(outfile, &stats);
+            printf("Stalls: reader %u, converter %u, writer %u\n",
+                   stats.stalls[0], stats.stalls[1], stats.stalls[2]);
+        }
+        else {
+            printShortfall(&stats);
+        }
+        aaxDriverDestroy(config);
+    }
+
+    freeInputList(&files);
+    free(tmpl);
+    for (i=0; i<num_outputs; ++i) {
+        free(outputs[i].file);
+    }
+
+    return rv;
+}
@@ -45,6 +45,8 @@
 #include <aax/aax.h>
 
 #include "base/types.h"
+#include "base/timer.h"
+#include "base/threads.h"
 #include "playlist.h"
 #include "driver.h"
 #include "wavfile.h"
@@ -52,6 +54,12 @@
 #define IFILE_PATH		SRC_PATH"/stereo.mp3"
 #define OFILE_PATH		"aaxout.wav"
 
+#define PROGRESS_INTERVAL	0.25f	/* seconds between display updates */
+#define STATE_INTERVAL		1.0f	/* state checks of streams and emitters */
+#define MIN_INTERVAL		0.01f
+#define MAX_EMITTER_TIME	30.0f
+#define BATCH_REFRESH_RATE	8	/* large blocks for offline rendering */
+
 void
 help()
 {
@@ -70,8 +78,10 @@ help()
     printf("  -c, --capture <device>\tcapture from an audio device\n");
     printf("  -d, --device <device>\t\tplayback device (default if not specified)\n");
     printf("  -o, --output <file>\t\talso write to an audio file (optional)\n");
-    printf("  -b, --batch\t\t\tprocess as fast as possible (Audio Files only)\n");
+    printf("  -b, --batch\t\t\trender to the output file as fast as possible\n");
+    printf("  -s, --shuffle\t\t\tplay the entries of a playlist in random order\n");
     printf("  -t, --time\t\t\ttime offset in seconds or (hh:)mm:ss\n");
+    printf("  -x, --crossfade <sec>\t\tcrossfade between playlist entries\n");
     printf("  -v, --verbose\t\t\tshow extra playback information\n");
     printf("  -h, --help\t\t\tprint this message and exit\n");
     printf("Either --input or --capture can be used but not both.\n");
@@ -79,6 +89,8 @@ help()
 
     printf("\nAudio will always be sent to the (default) audio device,\n");
     printf("writing to an output file is fully optional.\n");
+    printf("In batch mode the audio is only written to the output file and "
+           "a report of\nthe rendering speed is printed when done.\n");
 
     cfgi = aaxDriverGetByName("AeonWave on Audio Files", AAX_MODE_READ);
     cfgo = aaxDriverGetByName("AeonWave on Audio Files", AAX_MODE_WRITE_STEREO);
@@ -114,6 +126,551 @@ help()
     exit(-1);
 }
 
+/*
+ * Gapless playback of the entries of a playlist. While an entry plays the
+ * next one is opened, registered and initialized by a prefetch thread so it
+ * only has to be started, with its stream already buffering, when the
+ * current entry is about to end.
+ *
+ * For crossfading every entry gets its own audio frame. Both frames play at
+ * the same time during the fade and get an equal-power timed gain envelope,
+ * which the mixer applies to every block it renders. If the timed gain
+ * filter is not available for audio frames the volume of both frames is
+ * stepped once every mixer period by playerGetState instead.
+ */
+typedef struct
+{
+    aaxConfig config;
+    aaxFrame frame;		/* register the entries here if not NULL */
+    float pitch;
+    float lead;			/* start the next entry this early */
+    float fade;			/* crossfade time in seconds, 0 for none */
+
+    struct playlist_t *list;
+    unsigned int pos;		/* playlist position of record */
+    unsigned int next_pos;	/* playlist position of next */
+
+    aaxConfig record;		/* the playing entry */
+    aaxConfig next;		/* the prefetched entry, if any */
+    aaxConfig done;		/* the previous entry, if still open */
+    aaxFrame record_frame;	/* the crossfade frames of the entries */
+    aaxFrame next_frame;
+    aaxFrame done_frame;
+
+    float fade_time;		/* length of the stepped crossfade */
+    int fading;			/* a stepped crossfade is in progress */
+
+    _aaxThread thread;
+    int prefetching;
+} _player_t;
+
+/* open the first entry, starting at pos, which can be opened */
+static aaxConfig
+playerOpen(_player_t *p, unsigned int *pos)
+{
+    aaxConfig rv = NULL;
+
+    while (*pos < p->list->num)
+    {
+        rv = aaxDriverOpenByName(p->list->entries[*pos].devname,
+                                 AAX_MODE_READ);
+        if (rv) break;
+        (*pos)++;
+    }
+    return rv;
+}
+
+/*
+ * Register the sensor, set it's pitch and initialize it. When crossfading
+ * the sensor is registered with a new audio frame which is returned in
+ * frame.
+ */
+static int
+playerInitSensor(_player_t *p, aaxConfig record, aaxFrame *frame)
+{
+    int rv;
+
+    *frame = NULL;
+    if (p->fade > 0.0f)
+    {
+        *frame = aaxAudioFrameCreate(p->config);
+        if (!*frame) return AAX_FALSE;
+
+        if (p->frame) {
+            rv = aaxAudioFrameRegisterAudioFrame(p->frame, *frame);
+        } else {
+            rv = aaxMixerRegisterAudioFrame(p->config, *frame);
+        }
+        if (rv) rv = aaxAudioFrameSetState(*frame, AAX_PLAYING);
+        if (rv) rv = aaxAudioFrameRegisterSensor(*frame, record);
+    }
+    else if (p->frame) {
+        rv = aaxAudioFrameRegisterSensor(p->frame, record);
+    } else {
+        rv = aaxMixerRegisterSensor(p->config, record);
+    }
+
+    if (rv && p->pitch != 1.0f)
+    {
+        aaxEffect effect;
+
+        effect = aaxMixerGetEffect(record, AAX_DYNAMIC_PITCH_EFFECT);
+        if (effect)
+        {
+            aaxEffectSetSlot(effect, 0, AAX_LINEAR,
+                             0.0f, p->frame ? 0.5f : 0.06f, p->pitch, 0.0f);
+            aaxEffectSetState(effect, AAX_TRIANGLE);
+            aaxMixerSetEffect(record, effect);
+            aaxEffectDestroy(effect);
+        }
+    }
+
+    /** must be called after aaxMixerRegisterSensor */
+    if (rv) {
+        rv = aaxMixerSetState(record, AAX_INITIALIZED);
+    }
+    return rv;
+}
+
+static void
+playerCloseSensor(_player_t *p, aaxConfig record, aaxFrame frame)
+{
+    aaxSensorSetState(record, AAX_STOPPED);
+    if (frame)
+    {
+        aaxAudioFrameDeregisterSensor(frame, record);
+        aaxAudioFrameSetState(frame, AAX_STOPPED);
+        if (p->frame) {
+            aaxAudioFrameDeregisterAudioFrame(p->frame, frame);
+        } else {
+            aaxMixerDeregisterAudioFrame(p->config, frame);
+        }
+        aaxAudioFrameDestroy(frame);
+    }
+    else if (p->frame) {
+        aaxAudioFrameDeregisterSensor(p->frame, record);
+    } else {
+        aaxMixerDeregisterSensor(p->config, record);
+    }
+    aaxDriverClose(record);
+    aaxDriverDestroy(record);
+}
+
+static void*
+_playerPrefetchThread(void *id)
+{
+    _player_t *p = (_player_t*)id;
+    aaxFrame frame = NULL;
+    aaxConfig next;
+
+    p->next_pos = p->pos+1;
+    while ((next = playerOpen(p, &p->next_pos)) != NULL)
+    {
+        if (playerInitSensor(p, next, &frame)) break;
+
+        playerCloseSensor(p, next, frame);
+        p->next_pos++;
+    }
+    p->next_frame = frame;
+    p->next = next;
+
+    return NULL;
+}
+
+static void
+playerPrefetch(_player_t *p)
+{
+    p->prefetching = AAX_FALSE;
+    if (p->pos+1 < p->list->num)
+    {
+        if (_aaxThreadCreate(&p->thread, _playerPrefetchThread, p) == 0) {
+            p->prefetching = AAX_TRUE;
+        } else {
+            _playerPrefetchThread(p);
+        }
+    }
+}
+
+#define FADE_SLOTS		4
+
+/*
+ * Fade the frame in or out using a piecewise linear approximation of the
+ * equal-power gain curves sin(x) and cos(x) for x from 0 to pi/2. Every
+ * slot of the timed gain filter holds two gain levels and the time it takes
+ * to reach the next level, the last level is held.
+ */
+static int
+playerSetFade(_player_t *p, aaxFrame frame, float time, int fade_in)
+{
+    int i, rv = AAX_FALSE;
+    aaxFilter filter;
+
+    filter = aaxFilterCreate(p->config, AAX_TIMED_GAIN_FILTER);
+    if (filter)
+    {
+        float level[2*FADE_SLOTS], dt[2*FADE_SLOTS];
+        int steps = 2*FADE_SLOTS-2;
+
+        for (i=0; i<2*FADE_SLOTS; ++i)
+        {
+            float x = 0.5f*GMATH_PI*_MIN(i, steps)/steps;
+            level[i] = fade_in ? sinf(x) : cosf(x);
+            dt[i] = (i < steps) ? time/steps : AAX_FPINFINITE;
+        }
+
+        rv = AAX_TRUE;
+        for (i=0; rv && i<FADE_SLOTS; ++i)
+        {
+            rv = aaxFilterSetSlot(filter, i, AAX_LINEAR,
+                                  level[2*i], dt[2*i],
+                                  level[2*i+1], dt[2*i+1]);
+        }
+        if (rv) rv = aaxFilterSetState(filter, AAX_TRUE);
+        if (rv) rv = aaxAudioFrameSetFilter(frame, filter);
+        aaxFilterDestroy(filter);
+    }
+    return rv;
+}
+
+static void
+playerSetGain(aaxFrame frame, float gain)
+{
+    aaxFilter filter = aaxAudioFrameGetFilter(frame, AAX_VOLUME_FILTER);
+    if (filter)
+    {
+        aaxFilterSetParam(filter, AAX_GAIN, AAX_LINEAR, gain);
+        aaxAudioFrameSetFilter(frame, filter);
+        aaxFilterDestroy(filter);
+    }
+}
+
+/* step the gains of a crossfade which is not handled by the mixer */
+static void
+playerStepFade(_player_t *p)
+{
+    float freq = (float)aaxMixerGetSetup(p->record, AAX_FREQUENCY);
+    float t = 1.0f;
+
+    if (freq > 0.0f)
+    {
+        int64_t offs = aaxSensorGetOffset(p->record, AAX_SAMPLES);
+        t = _MIN(offs/(freq*p->pitch*p->fade_time), 1.0f);
+    }
+
+    playerSetGain(p->record_frame, sinf(0.5f*GMATH_PI*t));
+    if (p->done_frame) {
+        playerSetGain(p->done_frame, cosf(0.5f*GMATH_PI*t));
+    }
+    if (t >= 1.0f) p->fading = AAX_FALSE;
+}
+
+/*
+ * Start the prefetched entry and crossfade from the current entry to it
+ * over fade seconds. Returns AAX_FALSE at the end of the list.
+ */
+static int
+playerNext(_player_t *p, float fade)
+{
+    if (p->prefetching)
+    {
+        _aaxThreadJoin(p->thread);
+        p->prefetching = AAX_FALSE;
+    }
+
+    if (!p->next) {
+        return AAX_FALSE;
+    }
+
+    /* the entry before the current one has played out by now */
+    if (p->done)
+    {
+        playerCloseSensor(p, p->done, p->done_frame);
+        p->done = NULL;
+    }
+
+    p->fading = AAX_FALSE;
+    if (fade > 0.0f && p->next_frame && p->record_frame)
+    {
+        if (playerSetFade(p, p->next_frame, fade, AAX_TRUE)) {
+            playerSetFade(p, p->record_frame, fade, AAX_FALSE);
+        }
+        else
+        {
+            playerSetGain(p->next_frame, 0.0f);
+            p->fade_time = fade;
+            p->fading = AAX_TRUE;
+        }
+    }
+
+    aaxSensorSetState(p->next, AAX_CAPTURING);
+    p->done = p->record;
+    p->done_frame = p->record_frame;
+    p->record = p->next;
+    p->record_frame = p->next_frame;
+    p->pos = p->next_pos;
+    p->next = NULL;
+    p->next_frame = NULL;
+
+    playerPrefetch(p);
+
+    return AAX_TRUE;
+}
+
+/* seconds left to play of an entry or -1 if unknown */
+static float
+playerGetRemaining(_player_t *p, aaxConfig record)
+{
+    unsigned int max_samples = aaxMixerGetSetup(record, AAX_SAMPLES_MAX);
+    float freq = (float)aaxMixerGetSetup(record, AAX_FREQUENCY);
+    float rv = -1.0f;
+
+    if (max_samples && freq > 0.0f)
+    {
+        int64_t offs = aaxSensorGetOffset(record, AAX_SAMPLES);
+        rv = _MAX((max_samples - offs)/(freq*p->pitch), 0.0f);
+    }
+    return rv;
+}
+
+/*
+ * Returns AAX_PLAYING as long as there is something left to play. The next
+ * entry is started once the current entry has less than the crossfade time
+ * left, or without crossfading less than lead seconds. That keeps the gap
+ * between both entries to within half a mixer period. Entries of unknown
+ * length can not be crossfaded and are followed when they have ended.
+ * An entry shorter than twice the crossfade time is not faded out before
+ * the previous entry has faded out completely, so that no more than two
+ * entries play at the same time and no fade is cut short.
+ */
+static int
+playerGetState(_player_t *p)
+{
+    int state = aaxMixerGetState(p->record);
+
+    if (p->fading) {
+        playerStepFade(p);
+    }
+
+    if (p->done && !p->fading && aaxMixerGetState(p->done) != AAX_PLAYING)
+    {
+        playerCloseSensor(p, p->done, p->done_frame);
+        p->done = NULL;
+        p->done_frame = NULL;
+    }
+
+    if (p->prefetching || p->next)
+    {
+        float remain = playerGetRemaining(p, p->record);
+        float lead = _MAX(p->fade, p->lead);
+        int fading_in = (p->fade > 0.0f && p->done);
+
+        if (state != AAX_PLAYING ||
+            (!fading_in && remain >= 0.0f && remain <= lead))
+        {
+            float fade = 0.0f;
+            if (state == AAX_PLAYING && p->fade > 0.0f) {
+                fade = _MIN(p->fade, remain);
+            }
+            if (playerNext(p, fade)) {
+                state = AAX_PLAYING;
+            }
+        }
+    }
+    return state;
+}
+
+/* seconds until playerGetState has to be called again, -1 if unknown */
+static float
+playerGetWait(_player_t *p)
+{
+    float rv = playerGetRemaining(p, p->record);
+
+    if (rv >= 0.0f && (p->prefetching || p->next))
+    {
+        rv = _MAX(rv - _MAX(p->fade, p->lead), 0.0f);
+        if (p->fade > 0.0f && p->done) {
+            rv = _MAX(rv, playerGetRemaining(p, p->done));
+        }
+    }
+    if (p->fading && (rv < 0.0f || rv > 2.0f*p->lead)) {
+        rv = 2.0f*p->lead;
+    }
+    if (p->done && (rv < 0.0f || rv > STATE_INTERVAL)) {
+        rv = STATE_INTERVAL;
+    }
+    return rv;
+}
+
+static void
+playerStop(_player_t *p)
+{
+    if (p->prefetching)
+    {
+        _aaxThreadJoin(p->thread);
+        p->prefetching = AAX_FALSE;
+    }
+
+    if (p->next)
+    {
+        playerCloseSensor(p, p->next, p->next_frame);
+        p->next = NULL;
+    }
+
+    if (p->done)
+    {
+        playerCloseSensor(p, p->done, p->done_frame);
+        p->done = NULL;
+    }
+
+    if (p->record)
+    {
+        playerCloseSensor(p, p->record, p->record_frame);
+        p->record = NULL;
+    }
+}
+
+static void
+printSensorInfo(aaxConfig record)
+{
+    int64_t samples = aaxMixerGetSetup(record, AAX_SAMPLES_MAX);
+    int rate = aaxMixerGetSetup(record, AAX_FREQUENCY);
+    int bps = aaxGetBitsPerSample(aaxMixerGetSetup(record, AAX_FORMAT));
+    int bitrate = aaxMixerGetSetup(record, AAX_BIT_RATE);
+    int tracks = aaxMixerGetSetup(record, AAX_TRACKS);
+    int vbr = (bitrate < 0) ? AAX_TRUE : AAX_FALSE;
+    const char *s;
+
+    bitrate = abs(bitrate);
+    if (samples) {
+        printf(" Audio format: %i Hz, %i bits/sample, %s%.1f kbps, "
+               "%i tracks, %" PRIu64 " samples\n", rate, bps, vbr ? "~" : "",
+                1e-3f*bitrate, tracks, samples);
+    } else {
+        printf(" Audio format: %i Hz, %i bits/sample, %s%i kbps, "
+             "%i tracks\n", rate, bps, vbr ? "~" : "", bitrate, tracks);
+    }
+
+    s = aaxDriverGetSetup(record, AAX_MUSIC_PERFORMER_STRING);
+    if (s) printf(" Performer: %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_TRACK_TITLE_STRING);
+    if (s) printf(" Title    : %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_ALBUM_NAME_STRING);
+    if (s) printf(" Album    : %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_SONG_COMPOSER_STRING);
+    if (s) printf(" Composer : %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_ORIGINAL_PERFORMER_STRING);
+    if (s) printf(" Original : %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_MUSIC_GENRE_STRING);
+    if (s) printf(" Genre    : %s\n", s);
+    s = aaxDriverGetSetup(record, AAX_RELEASE_DATE_STRING);
+    if (s) printf(" Release date: %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_TRACK_NUMBER_STRING);
+    if (s) printf(" Track number: %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_SONG_COPYRIGHT_STRING);
+    if (s) printf(" Copyright:  %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_WEBSITE_STRING);
+    if (s) printf(" Website  : %s\n", s);
+
+    s = aaxDriverGetSetup(record, AAX_SONG_COMMENT_STRING);
+    if (s) printf(" Comment  : %s\n", s);
+}
+
+/* the playlist position and the title of the playlist entry, if any */
+static void
+printEntryInfo(_player_t *p)
+{
+    struct playlist_item_t *item = &p->list->entries[p->pos];
+
+    if (p->list->num > 1 || item->title)
+    {
+        printf(" Entry    : %u of %u", p->pos+1, p->list->num);
+        if (item->title) printf(", %s", item->title);
+        printf("\n");
+    }
+}
+
+/*
+ * Set up the progress format string for the duration of record and return
+ * the duration in seconds, or AAX_FPINFINITE if it is unknown.
+ */
+static float
+getProgressFormat(aaxConfig record, char *tstr, size_t len, float *dhour)
+{
+    float freq = 0.0f, duration, minutes, seconds;
+    unsigned int max_samples = 0;
+
+    if (record)
+    {
+        freq = (float)aaxMixerGetSetup(record, AAX_FREQUENCY);
+        max_samples = aaxMixerGetSetup(record, AAX_SAMPLES_MAX);
+    }
+
+    if (max_samples)
+    {
+        duration = (float)max_samples/freq;
+        seconds = duration;
+        *dhour = floorf(seconds/(60.0f*60.0f));
+        seconds -= *dhour*60.0f*60.0f;
+        minutes = floorf(seconds/60.0f);
+        seconds -= minutes*60.0f;
+        if (*dhour) {
+           snprintf(tstr, len, "%s  %02.0f:%02.0f:%02.0f %s\r",
+                               "pos: % 5.1f (%02.0f:%02.0f:%04.1f) of ",
+                               *dhour, minutes, seconds, " % 3.0f%, "
+                               "buffer: %3i%%");
+        } else {
+           snprintf(tstr, len, "%s  %02.0f:%02.0f %s\r",
+                               "pos: % 5.1f (%02.0f:%04.1f) of ",
+                               minutes, seconds, " % 3.0f%, "
+                               "buffer: %3i%%");
+       }
+    }
+    else
+    {
+       *dhour = duration = AAX_FPINFINITE;
+       snprintf(tstr, len, "%s\r", "pos: % 5.1f (%02.0f:%02.0f:%04.1f), buffer: %3i%%");
+    }
+    return duration;
+}
+
+/*
+ * Render the input in large blocks in batched mode, as fast as the decoder
+ * and the mixer allow and without any terminal I/O. Emitters, which may
+ * loop forever, are stopped after MAX_EMITTER_TIME seconds of audio.
+ * Returns the number of seconds of rendered audio.
+ */
+static float
+renderOffline(aaxConfig config, _player_t *player, aaxEmitter emitter)
+{
+    int rate = aaxMixerGetSetup(config, AAX_REFRESH_RATE);
+    float period = 1.0f/_MAX(rate, 1);
+    float rendered = 0.0f;
+    int state;
+
+    do
+    {
+        aaxMixerSetState(config, AAX_UPDATE);
+        rendered += period;
+
+        if (player) {
+            state = playerGetState(player);
+        } else {
+            state = aaxEmitterGetState(emitter);
+        }
+    }
+    while (state == AAX_PLAYING && (player || rendered < MAX_EMITTER_TIME));
+
+    return rendered;
+}
+
 int main(int argc, char **argv)
 {
     char *devname, *idevname;
@@ -124,8 +681,14 @@ int main(int argc, char **argv)
     aaxConfig config = NULL;
     aaxConfig record = NULL;
     aaxConfig file = NULL;
+    struct playlist_t *list = NULL;
+    _player_t player;
     float gain = 1.0f;
     int verbose = 0;
+    int batch = 0;
+    int shuffle = 0;
+    float crossfade = 0.0f;
+    const char *s;
     int64_t res;
     int rv = 0;
 
@@ -141,6 +704,16 @@ int main(int argc, char **argv)
         verbose = 1;
     }
 
+    if (getCommandLineOption(argc, argv, "-s") ||
+        getCommandLineOption(argc, argv, "--shuffle"))
+    {
+        shuffle = 1;
+    }
+
+    s = getCommandLineOption(argc, argv, "-x");
+    if (!s) s = getCommandLineOption(argc, argv, "--crossfade");
+    if (s) crossfade = _MAX((float)atof(s), 0.0f);
+
     gain = getGain(argc, argv);
     idevname = getCaptureName(argc, argv);
     infile = getInputFile(argc, argv, IFILE_PATH);
@@ -174,32 +747,49 @@ int main(int argc, char **argv)
         }
     }
 
-    devname = getDeviceName(argc, argv);
+    /* batch mode renders straight to the output file */
+    batch = getCommandLineOption(argc, argv, "-b") ||
+            getCommandLineOption(argc, argv, "--batch");
+    outfile = getOutputFile(argc, argv, NULL);
+    if (outfile) {
+        snprintf(obuf, 256, "AeonWave on Audio Files: %s", outfile);
+    }
+
+    if (batch && outfile) {
+        devname = obuf;
+    } else {
+        devname = getDeviceName(argc, argv);
+    }
     config = aaxDriverOpenByName(devname, AAX_MODE_WRITE_STEREO);
     testForError(config, "Audio output device is not available.");
 
+    memset(&player, 0, sizeof(player));
     if (config)
     {
         if (idevname)
         {
-            // treat as a playlist
-            idevname = getURLFromPlaylist(config, idevname);
-            record = aaxDriverOpenByName(idevname, AAX_MODE_READ);
+            // treat as a playlist, a single file is a list of one entry
+            list = playlistOpen(config, idevname, shuffle);
+            if (list)
+            {
+                player.config = config;
+                player.list = list;
+                record = playerOpen(&player, &player.pos);
+            }
+
             if (!record)
             {
                 printf("File not found: %s\n", infile);
                 exit(-1);
             }
+            player.record = record;
         }
         else {
             buffer = bufferFromFile(config, infile);
         }
     }
 
-    outfile = getOutputFile(argc, argv, NULL);
-    if (outfile)
-    {
-        snprintf(obuf, 256, "AeonWave on Audio Files: %s", outfile);
+    if (outfile && !batch) {
         file = aaxDriverOpenByName(obuf, AAX_MODE_WRITE_STEREO);
     }
     else {
@@ -208,29 +798,35 @@ int main(int argc, char **argv)
 
     if (config && (record || buffer) && (rv >= 0))
     {
-        char batch = getCommandLineOption(argc, argv, "-b") ||
-                     getCommandLineOption(argc, argv, "--batch");
         char fparam = getCommandLineOption(argc, argv, "-f") ||
                       getCommandLineOption(argc, argv, "-frame");
         float pitch = getPitch(argc, argv);
         float dhour, hour, minutes, seconds;
         float duration, freq;
-        unsigned int max_samples;
+        _aaxTimer *timer;
         int key, paused;
         aaxFrame frame = NULL;
         aaxEffect effect;
         aaxFilter filter;
-        const char *s;
         char tstr[80];
         int state;
-        float dt;
-
-        if (batch && !aaxMixerGetSetup(config, AAX_BATCHED_MODE)) {
-            printf("Warning: Batched mode not supported for this backend\n");
+        float dt, wait;
+
+        /*
+         * Without batched mode support AAX_UPDATE does not render anything
+         * and the rendering speed could not be measured, e.g. for -b
+         * without -o on a regular playback device.
+         */
+        if (batch && !aaxMixerGetSetup(config, AAX_BATCHED_MODE))
+        {
+            printf("Warning: Batched mode not supported for this backend, "
+                   "playing in real time\n");
+            batch = 0;
         }
 
         /** mixer */
-        res = aaxMixerSetSetup(config, AAX_REFRESH_RATE, 64);
+        res = aaxMixerSetSetup(config, AAX_REFRESH_RATE,
+                               batch ? BATCH_REFRESH_RATE : 64);
         testForState(res, "aaxMixerSetSetup");
 
         res = aaxMixerSetState(config, AAX_INITIALIZED);
@@ -239,6 +835,10 @@ int main(int argc, char **argv)
         res = aaxMixerSetState(config, AAX_PLAYING);
         testForState(res, "aaxMixerStart");
 
+        player.pitch = pitch;
+        player.lead = 0.5f/_MAX(aaxMixerGetSetup(config, AAX_REFRESH_RATE), 1);
+        player.fade = crossfade;
+
         if (fparam) /** audio frame */
         {
             printf("  using audio-frames\n");
@@ -271,19 +871,11 @@ int main(int argc, char **argv)
                 aaxEffectDestroy(effect);
                 testForState(res, "aaxEffectDestroy");
             }
-
-            /** sensor */
-            res = aaxAudioFrameRegisterSensor(frame, record);
-            testForState(res, "aaxAudioFrameRegisterSensor");
+            player.frame = frame;
         }
         else /** sensor */
         {
-            if (record)
-            {
-                res = aaxMixerRegisterSensor(config, record);
-                testForState(res, "aaxMixerRegisterSensor");
-            }
-            else
+            if (!record)
             {
                 emitter = aaxEmitterCreate();
                 testForError(emitter, "Unable to create a new emitter");
@@ -299,13 +891,9 @@ int main(int argc, char **argv)
             }
         }
 
-        if (pitch != 1.0f)
+        if (!record && pitch != 1.0f)
         {
-            if (record) {
-                effect = aaxMixerGetEffect(record, AAX_DYNAMIC_PITCH_EFFECT);
-            } else {
-                effect = aaxEmitterGetEffect(emitter, AAX_DYNAMIC_PITCH_EFFECT);
-            }
+            effect = aaxEmitterGetEffect(emitter, AAX_DYNAMIC_PITCH_EFFECT);
             testForError(effect, "aaxEffectCreate");
 
             res = aaxEffectSetSlot(effect, 0, AAX_LINEAR,
@@ -315,11 +903,7 @@ int main(int argc, char **argv)
             res = aaxEffectSetState(effect, AAX_TRIANGLE);
             testForState(res, "aaxEffectSetState");
 
-            if (record) {
-                res = aaxMixerSetEffect(record, effect);
-            } else {
-                res = aaxEmitterSetEffect(emitter, effect);
-            }
+            res = aaxEmitterSetEffect(emitter, effect);
             testForState(res, "aaxEmitterSetEffect");
 
             res = aaxEffectDestroy(effect);
@@ -342,10 +926,9 @@ int main(int argc, char **argv)
             res = aaxFilterDestroy(filter);
         }
 
-        /** must be called after aaxMixerRegisterSensor */
         if (record)
         {
-            res = aaxMixerSetState(record, AAX_INITIALIZED);
+            res = playerInitSensor(&player, record, &player.record_frame);
             if (!res) {
                printf("%s\n", aaxGetErrorString(aaxGetErrorNo()));
                exit(-1);
@@ -361,6 +944,9 @@ int main(int argc, char **argv)
 
             res = aaxSensorSetState(record, AAX_CAPTURING);
             testForState(res, "aaxSensorCaptureStart");
+
+            /* open the next playlist entry while this one plays */
+            playerPrefetch(&player);
         }
 
         s = aaxDriverGetSetup(record, AAX_MUSIC_PERFORMER_UPDATE);
@@ -371,57 +957,10 @@ int main(int argc, char **argv)
 
         if (record && verbose)
         {
-            int64_t samples = aaxMixerGetSetup(record, AAX_SAMPLES_MAX);
-            int rate = aaxMixerGetSetup(record, AAX_FREQUENCY);
-            int bps = aaxGetBitsPerSample(aaxMixerGetSetup(record, AAX_FORMAT));
-            int bitrate = aaxMixerGetSetup(record, AAX_BIT_RATE);
-            int tracks = aaxMixerGetSetup(record, AAX_TRACKS);
-            int vbr = (bitrate < 0) ? AAX_TRUE : AAX_FALSE;
-
             s = aaxDriverGetSetup(config, AAX_NAME_STRING);
             printf(" Playback driver: %s\n", s);
-
-            bitrate = abs(bitrate);
-            if (samples) {
-                printf(" Audio format: %i Hz, %i bits/sample, %s%.1f kbps, "
-                       "%i tracks, %" PRIu64 " samples\n", rate, bps, vbr ? "~" : "",
-                        1e-3f*bitrate, tracks, samples);
-            } else {
-                printf(" Audio format: %i Hz, %i bits/sample, %s%i kbps, "
-                     "%i tracks\n", rate, bps, vbr ? "~" : "", bitrate, tracks);
-            }
-
-            s = aaxDriverGetSetup(record, AAX_MUSIC_PERFORMER_STRING);
-            if (s) printf(" Performer: %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_TRACK_TITLE_STRING);
-            if (s) printf(" Title    : %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_ALBUM_NAME_STRING);
-            if (s) printf(" Album    : %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_SONG_COMPOSER_STRING);
-            if (s) printf(" Composer : %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_ORIGINAL_PERFORMER_STRING);
-            if (s) printf(" Original : %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_MUSIC_GENRE_STRING);
-            if (s) printf(" Genre    : %s\n", s);
-            s = aaxDriverGetSetup(record, AAX_RELEASE_DATE_STRING);
-            if (s) printf(" Release date: %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_TRACK_NUMBER_STRING);
-            if (s) printf(" Track number: %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_SONG_COPYRIGHT_STRING);
-            if (s) printf(" Copyright:  %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_WEBSITE_STRING);
-            if (s) printf(" Website  : %s\n", s);
-
-            s = aaxDriverGetSetup(record, AAX_SONG_COMMENT_STRING);
-            if (s) printf(" Comment  : %s\n", s);
+            printEntryInfo(&player);
+            printSensorInfo(record);
         }
 
         if (file)
@@ -433,134 +972,174 @@ int main(int argc, char **argv)
             testForState(res, "aaxSensorCaptureStart");
         }
 
-        freq = 0;
-        max_samples = 0;
-        if (record)
-        {
-            freq = (float)aaxMixerGetSetup(record, AAX_FREQUENCY);
-            max_samples = aaxMixerGetSetup(record, AAX_SAMPLES_MAX);
-        }
-        if (max_samples)
-        {
-            duration = (float)max_samples/freq;
-            seconds = duration;
-            dhour = floorf(seconds/(60.0f*60.0f));
-            seconds -= dhour*60.0f*60.0f;
-            minutes = floorf(seconds/60.0f);
-            seconds -= minutes*60.0f;
-            if (dhour) {
-               snprintf(tstr, 80, "%s  %02.0f:%02.0f:%02.0f %s\r",
-                                  "pos: % 5.1f (%02.0f:%02.0f:%04.1f) of ",
-                                  dhour, minutes, seconds, " % 3.0f%, "
-                                  "buffer: %3i%%");
-            } else {
-               snprintf(tstr, 80, "%s  %02.0f:%02.0f %s\r",
-                                  "pos: % 5.1f (%02.0f:%04.1f) of ",
-                                  minutes, seconds, " % 3.0f%, "
-                                  "buffer: %3i%%");
-           }
-        }
-        else
-        {
-           dhour = duration = AAX_FPINFINITE;
-           snprintf(tstr, 80, "%s\r", "pos: % 5.1f (%02.0f:%02.0f:%04.1f), buffer: %3i%%");
-        }
+        freq = record ? (float)aaxMixerGetSetup(record, AAX_FREQUENCY) : 0.0f;
+        duration = getProgressFormat(record, tstr, 80, &dhour);
+
+        timer = _aaxTimerCreate();
+        _aaxTimerStart(timer);
 
         dt = 0.0f;
         paused = AAX_FALSE;
-        set_mode(1);
-        do
+        if (batch)
+        {
+            double elapsed;
+            uint64_t rss;
+
+            dt = renderOffline(config, record ? &player : NULL, emitter);
+            elapsed = _MAX(_aaxTimerElapsed(timer), 1e-6);
+            rss = getPeakMemoryUsage();
+
+            printf("Rendered %.1f sec. of audio in %.3f sec. "
+                   "(%.1fx realtime)", dt, elapsed, dt/elapsed);
+            if (rss) printf(", peak memory usage: %.1f MB",
+                            rss/(1024.0*1024.0));
+            printf("\n");
+            if (!record && dt >= MAX_EMITTER_TIME) {
+                printf("Stopped after %.0f seconds\n", MAX_EMITTER_TIME);
+            }
+        }
+        else
         {
-            if (verbose)
+            /*
+             * Sleep until a key is pressed, the display has to be updated or
+             * the input should have ended. Only inputs with an unknown length
+             * have their state checked at a regular interval.
+             */
+            set_mode(1);
+            do
             {
-                int fill = aaxMixerGetSetup(record, AAX_BUFFER_FILL);
-                float pos;
-
-                if (record)
+                if (record && player.record != record)
                 {
-                    const char *p, *t;
-
-                    pos = (float)aaxSensorGetOffset(record, AAX_SAMPLES)/freq;
-
-                    p = aaxDriverGetSetup(record, AAX_MUSIC_PERFORMER_UPDATE);
-                    t = aaxDriverGetSetup(record, AAX_TRACK_TITLE_UPDATE);
-                    if (p && t) {
-                        printf("\r\033[K Playing  : %s - %s\n", p, t);
-                    } else if (p) {
-                        printf("\r\033[K Performer: %s\n", p);
-                    } else if (t) {
-                        printf("\r\033[K Title    : %s\n", t);
+                    /* the next playlist entry started */
+                    record = player.record;
+                    freq = (float)aaxMixerGetSetup(record, AAX_FREQUENCY);
+                    duration = getProgressFormat(record, tstr, 80, &dhour);
+                    if (verbose)
+                    {
+                        printf("\r\033[K\n");
+                        printEntryInfo(&player);
+                        printSensorInfo(record);
                     }
                 }
-                else {
-                    pos = (float)aaxEmitterGetOffsetSec(emitter);
-                }
 
-                if (duration != AAX_FPINFINITE)
+                if (verbose)
                 {
-                    seconds = duration-pos;
-                    hour = floorf(seconds/(60.0f*60.0f));
-                    seconds -= hour*60.0f*60.0f;
-                    minutes = floorf(seconds/60.0f);
-                    seconds -= minutes*60.0f;
-                    if (dhour) {
-                       printf(tstr, pos, hour, minutes, seconds, 100*pos/duration, fill);
-                    } else {
-                       printf(tstr, pos, minutes, seconds, 100*pos/duration, fill);
+                    int fill = aaxMixerGetSetup(record, AAX_BUFFER_FILL);
+                    float pos;
+
+                    if (record)
+                    {
+                        const char *p, *t;
+
+                        pos = aaxSensorGetOffset(record, AAX_SAMPLES)/freq;
+
+                        p = aaxDriverGetSetup(record,
+                                              AAX_MUSIC_PERFORMER_UPDATE);
+                        t = aaxDriverGetSetup(record, AAX_TRACK_TITLE_UPDATE);
+                        if (p && t) {
+                            printf("\r\033[K Playing  : %s - %s\n", p, t);
+                        } else if (p) {
+                            printf("\r\033[K Performer: %s\n", p);
+                        } else if (t) {
+                            printf("\r\033[K Title    : %s\n", t);
+                        }
                     }
+                    else {
+                        pos = (float)aaxEmitterGetOffsetSec(emitter);
+                    }
+
+                    if (duration != AAX_FPINFINITE)
+                    {
+                        seconds = duration-pos;
+                        hour = floorf(seconds/(60.0f*60.0f));
+                        seconds -= hour*60.0f*60.0f;
+                        minutes = floorf(seconds/60.0f);
+                        seconds -= minutes*60.0f;
+                        if (dhour) {
+                           printf(tstr, pos, hour, minutes, seconds, 100*pos/duration, fill);
+                        } else {
+                           printf(tstr, pos, minutes, seconds, 100*pos/duration, fill);
+                        }
+                    }
+                    else
+                    {
+                        seconds = pos;
+                        hour = floorf(seconds/(60.0f*60.0f));
+                        seconds -= hour*60.0f*60.0f;
+                        minutes = floorf(seconds/60.0f);
+                        seconds -= minutes*60.0f;
+                        printf(tstr, pos, hour, minutes, seconds, fill);
+                    }
+                    fflush(stdout);
                 }
-                else
+
+                wait = -1.0f;
+                if (!paused)
                 {
-                    seconds = pos;
-                    hour = floorf(seconds/(60.0f*60.0f));
-                    seconds -= hour*60.0f*60.0f;
-                    minutes = floorf(seconds/60.0f);
-                    seconds -= minutes*60.0f;
-                    printf(tstr, pos, hour, minutes, seconds, fill);
+                    wait = STATE_INTERVAL;
+                    if (record)
+                    {
+                        float remain = playerGetWait(&player);
+                        if (remain >= 0.0f) wait = remain;
+                    }
+                    else
+                    {
+                        /* the emitter state is only known when checked */
+                        wait = _MIN(STATE_INTERVAL, MAX_EMITTER_TIME - dt);
+                    }
+
+                    wait = _MAX(wait, MIN_INTERVAL);
+                    if (verbose) wait = _MIN(wait, PROGRESS_INTERVAL);
                 }
-                fflush(stdout);
-            }
+                key = wait_key(wait);
 
-            key = get_key();
-            if (key)
-            {
-               if (key == ' ')
-               {
-                  if (paused)
-                  {
-                     aaxMixerSetState(config, AAX_PLAYING);
-                     printf("\nRestart playback.\n");
-                     paused = AAX_FALSE;
-                  }
-                  else
-                  {
-                     aaxMixerSetState(config, AAX_SUSPENDED);
-                     printf("\nPause playback.\n");
-                     paused = AAX_TRUE;
-                  }
-               }
-               else {
-                  break;
-               }
-            }
+                if (!paused) dt += _aaxTimerElapsed(timer);
+                _aaxTimerStart(timer);
 
-            if (batch) {
-               res = aaxMixerSetState(config, AAX_UPDATE);
-            } else {
-                msecSleep(250);
-            }
+                if (key == EOF)
+                {
+                   /* stdin is closed, nothing can resume the playback */
+                   if (paused)
+                   {
+                      aaxMixerSetState(config, AAX_PLAYING);
+                      printf("\nRestart playback.\n");
+                      paused = AAX_FALSE;
+                   }
+                }
+                else if (key)
+                {
+                   if (key == ' ')
+                   {
+                      if (paused)
+                      {
+                         aaxMixerSetState(config, AAX_PLAYING);
+                         printf("\nRestart playback.\n");
+                         paused = AAX_FALSE;
+                      }
+                      else
+                      {
+                         aaxMixerSetState(config, AAX_SUSPENDED);
+                         printf("\nPause playback.\n");
+                         paused = AAX_TRUE;
+                      }
+                   }
+                   else {
+                      break;
+                   }
+                }
 
-            if (record) {
-                state = aaxMixerGetState(record);
-            }
-            else {
-                state = aaxEmitterGetState(emitter);
-                dt += 0.25f;
+                if (record) {
+                    state = playerGetState(&player);
+                }
+                else {
+                    state = aaxEmitterGetState(emitter);
+                }
             }
+            while (state == AAX_PLAYING && (record || dt < MAX_EMITTER_TIME));
+            printf("\n");
+            set_mode(0);
         }
-        while (state == AAX_PLAYING && dt < 30.0f);
-        printf("\n");
-        set_mode(0);
+        _aaxTimerDestroy(timer);
 
         res = aaxMixerSetState(config, AAX_STOPPED);
         testForState(res, "aaxMixerSetState");
@@ -571,10 +1150,8 @@ int main(int argc, char **argv)
             testForState(res, "aaxAudioFrameSetState");
         }
 
-        if (record)
-        {
-            res = aaxSensorSetState(record, AAX_STOPPED);
-            testForState(res, "aaxSensorCaptureStop");
+        if (record) {
+            playerStop(&player);
         }
         else
         {
@@ -584,37 +1161,24 @@ int main(int argc, char **argv)
 
         if (frame)
         {
-            res = aaxAudioFrameDeregisterSensor(frame, record);
-            testForState(res, "aaxAudioFrameDeregisterSensor");
-
             res = aaxMixerDeregisterAudioFrame(config, frame);
             testForState(res, "aaxMixerDeregisterAudioFrame");
 
             res = aaxAudioFrameDestroy(frame);
             testForState(res, "aaxAudioFrameDestroy");
         }
-        else
+        else if (!record)
         {
-            if (record)
-            {
-                res = aaxMixerDeregisterSensor(config, record);
-                testForState(res, "aaxMixerDeregisterSensor");
-            }
-            else
-            {
-                res = aaxMixerDeregisterEmitter(config, emitter);
-                testForState(res, "aaxMixerDeregisterEmitter");
-            }
+            res = aaxMixerDeregisterEmitter(config, emitter);
+            testForState(res, "aaxMixerDeregisterEmitter");
         }
     }
     else {
         printf("Unable to open capture device.\n");
     }
 
-    if (record)
-    {
-        res = aaxDriverClose(record);
-        res = aaxDriverDestroy(record);
+    if (record) {
+        playerStop(&player);
     }
     else
     {
@@ -637,6 +1201,8 @@ int main(int argc, char **argv)
         testForState(res, "aaxDriverDestroy");
     }
 
+    playlistFree(list);
+
     res = aaxDriverClose(config);
     testForState(res, "aaxDriverClose");
 
@@ -46,6 +46,9 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_RESOURCE_H
+# include <sys/resource.h>
+#endif
 
 #include <base/logging.h>
 #include <base/memory.h>
@@ -358,16 +361,17 @@ getOutputFile(int argc, char **argv, const char *filename)
 }
 
 enum aaxFormat
-getAudioFormat(int argc, char **argv, enum aaxFormat format)
+getFormatFromString(const char *name, enum aaxFormat format)
 {
-   char *fn = getCommandLineOption(argc, argv, "-f");
    enum aaxFormat rv = 0;
+   char fn[64], *ptr;
+   size_t len;
 
-   if (!fn) fn = getCommandLineOption(argc, argv, "--format");
-   if (fn)
+   snprintf(fn, sizeof(fn), "%s", name);
+   len = strlen(fn);
+   if (len > strlen("_LE"))
    {
-      char *ptr = fn+strlen(fn)-strlen("_LE");
-
+      ptr = fn+len-strlen("_LE");
       if (!strcasecmp(ptr, "_LE"))
       {
          *ptr = 0;
@@ -378,46 +382,58 @@ getAudioFormat(int argc, char **argv, enum aaxFormat format)
          *ptr = 0;
          rv = AAX_FORMAT_BE;
       }
+   }
 
-      if (!strcasecmp(fn, "AAX_PCM8S")) {
-         rv = AAX_PCM8S;
-      } else if (!strcasecmp(fn, "AAX_PCM16S")) {
-         rv |= AAX_PCM16S;
-      } else if (!strcasecmp(fn, "AAX_PCM24S")) {
-         rv |= AAX_PCM24S;
-      } else if (!strcasecmp(fn, "AAX_PCM32S")) {
-         rv |= AAX_PCM32S;
-      } else if (!strcasecmp(fn, "AAX_FLOAT")) {
-         rv |= AAX_FLOAT;
-      } else if (!strcasecmp(fn, "AAX_DOUBLE")) {
-         rv |= AAX_DOUBLE;
-      } else if (!strcasecmp(fn, "AAX_MULAW")) {
-         rv = AAX_MULAW;
-      } else if (!strcasecmp(fn, "AAX_ALAW")) {
-         rv = AAX_ALAW;
-      } else if (!strcasecmp(fn, "AAX_IMA4_ADPCM")) {
-         rv = AAX_IMA4_ADPCM; 
-      } else if (!strcasecmp(fn, "AAX_PCM24S_PACKED")) {
-         rv = AAX_PCM24S_PACKED;
-
-      } else if (!strcasecmp(fn, "AAX_PCM8U")) {
-         rv = AAX_PCM8U;
-      } else if (!strcasecmp(fn, "AAX_PCM16U")) {
-         rv |= AAX_PCM16U;
-      } else if (!strcasecmp(fn, "AAX_PCM24U")) {
-         rv |= AAX_PCM24U;
-      } else if (!strcasecmp(fn, "AAX_PCM32U")) {
-         rv |= AAX_PCM32U;
-      } else if (!strcasecmp(fn, "AAX_AAXS16S") || !strcasecmp(fn, "AAX_AAXS24S")) {
-         rv = AAX_AAXS16S;
-      } else {
-         rv = format;
-      }
+   if (!strcasecmp(fn, "AAX_PCM8S")) {
+      rv = AAX_PCM8S;
+   } else if (!strcasecmp(fn, "AAX_PCM16S")) {
+      rv |= AAX_PCM16S;
+   } else if (!strcasecmp(fn, "AAX_PCM24S")) {
+      rv |= AAX_PCM24S;
+   } else if (!strcasecmp(fn, "AAX_PCM32S")) {
+      rv |= AAX_PCM32S;
+   } else if (!strcasecmp(fn, "AAX_FLOAT")) {
+      rv |= AAX_FLOAT;
+   } else if (!strcasecmp(fn, "AAX_DOUBLE")) {
+      rv |= AAX_DOUBLE;
+   } else if (!strcasecmp(fn, "AAX_MULAW")) {
+      rv = AAX_MULAW;
+   } else if (!strcasecmp(fn, "AAX_ALAW")) {
+      rv = AAX_ALAW;
+   } else if (!strcasecmp(fn, "AAX_IMA4_ADPCM")) {
+      rv = AAX_IMA4_ADPCM; 
+   } else if (!strcasecmp(fn, "AAX_PCM24S_PACKED")) {
+      rv = AAX_PCM24S_PACKED;
+
+   } else if (!strcasecmp(fn, "AAX_PCM8U")) {
+      rv = AAX_PCM8U;
+   } else if (!strcasecmp(fn, "AAX_PCM16U")) {
+      rv |= AAX_PCM16U;
+   } else if (!strcasecmp(fn, "AAX_PCM24U")) {
+      rv |= AAX_PCM24U;
+   } else if (!strcasecmp(fn, "AAX_PCM32U")) {
+      rv |= AAX_PCM32U;
+   } else if (!strcasecmp(fn, "AAX_AAXS16S") || !strcasecmp(fn, "AAX_AAXS24S")) {
+      rv = AAX_AAXS16S;
+   } else {
+      rv = format;
    }
 
    return rv;
 }
 
+enum aaxFormat
+getAudioFormat(int argc, char **argv, enum aaxFormat format)
+{
+   char *fn = getCommandLineOption(argc, argv, "-f");
+   enum aaxFormat rv = 0;
+
+   if (!fn) fn = getCommandLineOption(argc, argv, "--format");
+   if (fn) rv = getFormatFromString(fn, format);
+
+   return rv;
+}
+
 void
 testForError(void *p, char const *s)
 {
@@ -465,6 +481,25 @@ getCommandLineOption(int argc, char **argv, char const *option)
     return rv;
 }
 
+/* the peak resident set size of the process in bytes, or 0 if unknown */
+uint64_t
+getPeakMemoryUsage()
+{
+    uint64_t rv = 0;
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        rv = usage.ru_maxrss;
+# ifndef __APPLE__
+        rv *= 1024;		/* kilobytes */
+# endif
+    }
+#endif
+    return rv;
+}
+
 #ifndef _WIN32
 # include <termios.h>
 
@@ -499,6 +534,45 @@ int get_key()
     return c;
 }
 
+/*
+ * Wait until a key is pressed or until timeout seconds have passed,
+ * a negative timeout waits for a key only. Returns the key or 0.
+ * Once stdin is closed only the timeout is waited for, waiting for a key
+ * only then returns EOF at once since no key can ever arrive.
+ */
+int wait_key(float timeout)
+{
+    static int closed = 0;
+    struct timeval tv, *ptv = NULL;
+    int c = 0;
+    fd_set fs;
+
+    if (closed && timeout < 0.0f) {
+        return EOF;
+    }
+
+    if (timeout >= 0.0f)
+    {
+        tv.tv_sec = (time_t)timeout;
+        tv.tv_usec = (suseconds_t)((timeout - tv.tv_sec)*1e6f);
+        ptv = &tv;
+    }
+
+    FD_ZERO(&fs);
+    if (!closed) FD_SET(STDIN_FILENO, &fs);
+    if (select(closed ? 0 : STDIN_FILENO + 1, &fs, 0, 0, ptv) > 0 &&
+        FD_ISSET(STDIN_FILENO, &fs))
+    {
+        c = getchar();
+        if (c == EOF)
+        {
+            closed = 1;
+            c = wait_key(timeout);
+        }
+    }
+    return c;
+}
+
 #else
 
 # include <conio.h>
@@ -511,11 +585,286 @@ int get_key()
    return 0;
 }
 
+int wait_key(float timeout)
+{
+   HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+   DWORD ms = (timeout < 0.0f) ? INFINITE : (DWORD)(timeout*1000.0f);
+   DWORD start = GetTickCount();
+
+   /* the console also signals mouse and focus events */
+   while (WaitForSingleObject(in, ms) == WAIT_OBJECT_0)
+   {
+      DWORD waited;
+
+      if (kbhit()) return getch();
+      FlushConsoleInputBuffer(in);
+      if (ms == INFINITE) continue;
+
+      waited = GetTickCount() - start;
+      if (waited >= ms) break;
+      ms -= waited;
+      start += waited;
+   }
+   return 0;
+}
+
 void set_mode(int want_key)
 {
 }
+
+# include <io.h>
+
+void *
+simple_mmap(int fd, size_t length, SIMPLE_UNMMAP *un)
+{
+    HANDLE f = (HANDLE)_get_osfhandle(fd);
+    void *p = MAP_FAILED;
+
+    if (f != INVALID_HANDLE_VALUE)
+    {
+        un->m = CreateFileMapping(f, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (un->m)
+        {
+            p = MapViewOfFile(un->m, FILE_MAP_READ, 0, 0, length);
+            if (!p)
+            {
+                CloseHandle(un->m);
+                p = MAP_FAILED;
+            }
+        }
+    }
+    un->p = p;
+
+    return p;
+}
+
+void
+simple_unmmap(void *addr, size_t len, SIMPLE_UNMMAP *un)
+{
+    UnmapViewOfFile(un->p);
+    CloseHandle(un->m);
+}
 #endif
 
+typedef struct
+{
+    char **files;
+    unsigned int num;
+    unsigned int max;
+} _file_list_t;
+
+static int
+_matchExtension(const char *name, const char *ext)
+{
+    const char *dot = strrchr(name, '.');
+    int rv = AAX_FALSE;
+
+    if (!ext) {
+        rv = AAX_TRUE;
+    }
+    else if (dot++)
+    {
+        size_t len = strlen(dot);
+        while (*ext && !rv)
+        {
+            const char *end = strchr(ext, ',');
+            size_t elen = end ? (size_t)(end-ext) : strlen(ext);
+
+            rv = (elen == len && !strncasecmp(dot, ext, len));
+            ext += elen;
+            if (*ext == ',') ext++;
+        }
+    }
+    return rv;
+}
+
+static int
+_addFile(_file_list_t *list, const char *dir, const char *name)
+{
+    size_t dlen = dir ? strlen(dir) : 0;
+    size_t len = dlen + strlen(name) + 2;
+    char *path;
+
+    if (list->num == list->max)
+    {
+        unsigned int max = list->max ? 2*list->max : 256;
+        char **files = realloc(list->files, max*sizeof(char*));
+        if (!files) return AAX_FALSE;
+
+        list->files = files;
+        list->max = max;
+    }
+
+    path = malloc(len);
+    if (!path) return AAX_FALSE;
+
+    if (dir) snprintf(path, len, "%s/%s", dir, name);
+    else snprintf(path, len, "%s", name);
+    list->files[list->num++] = path;
+
+    return AAX_TRUE;
+}
+
+#ifndef _WIN32
+# include <dirent.h>
+# include <sys/stat.h>
+
+static void
+_addDirectory(_file_list_t *list, const char *dir, const char *ext)
+{
+    DIR *d = opendir(dir);
+    if (d)
+    {
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL)
+        {
+            int is_dir = AAX_FALSE, is_file = AAX_FALSE;
+
+            if (e->d_name[0] == '.') continue;	/* also skips . and .. */
+
+# if defined(_DIRENT_HAVE_D_TYPE) && defined(DT_DIR)
+            if (e->d_type == DT_DIR) is_dir = AAX_TRUE;
+            else if (e->d_type == DT_REG) is_file = AAX_TRUE;
+            else if (e->d_type == DT_LNK || e->d_type == DT_UNKNOWN)
+# endif
+            {
+                char path[4096];
+                struct stat st;
+
+                /*
+                 * Links to files are followed but links to directories are
+                 * not, a link loop like dir/loop -> . would never end.
+                 */
+                snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+                if (lstat(path, &st) == 0)
+                {
+                    int is_link = S_ISLNK(st.st_mode);
+                    if (!is_link || stat(path, &st) == 0)
+                    {
+                        is_dir = !is_link && S_ISDIR(st.st_mode);
+                        is_file = S_ISREG(st.st_mode);
+                    }
+                }
+            }
+
+            if (is_dir)
+            {
+                char path[4096];
+                snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+                _addDirectory(list, path, ext);
+            }
+            else if (is_file && _matchExtension(e->d_name, ext)) {
+                _addFile(list, dir, e->d_name);
+            }
+        }
+        closedir(d);
+    }
+}
+
+static int
+_isDirectory(const char *path)
+{
+    struct stat st;
+    return (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+}
+#else
+static void
+_addDirectory(_file_list_t *list, const char *dir, const char *ext)
+{
+    WIN32_FIND_DATA data;
+    char pattern[4096];
+    HANDLE h;
+
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    h = FindFirstFile(pattern, &data);
+    if (h != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (data.cFileName[0] == '.') continue;
+
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                /* do not follow junctions and links, they may loop */
+                if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+                    continue;
+                }
+
+                char path[4096];
+                snprintf(path, sizeof(path), "%s/%s", dir, data.cFileName);
+                _addDirectory(list, path, ext);
+            }
+            else if (_matchExtension(data.cFileName, ext)) {
+                _addFile(list, dir, data.cFileName);
+            }
+        }
+        while (FindNextFile(h, &data));
+        FindClose(h);
+    }
+}
+
+static int
+_isDirectory(const char *path)
+{
+    DWORD attr = GetFileAttributes(path);
+    return (attr != INVALID_FILE_ATTRIBUTES &&
+            (attr & FILE_ATTRIBUTE_DIRECTORY));
+}
+#endif
+
+static int
+_compareFiles(const void *a, const void *b)
+{
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+/**
+ * Get a sorted list of all files in a directory and its subdirectories.
+ * Hidden files and directories are skipped. A path which is not
+ * a directory is returned as the only entry of the list.
+ *
+ * @param path the directory to search
+ * @param ext a comma separated list of file extensions to match,
+ *        case insensitive, or NULL for all files
+ * @param num the returned number of files in the list
+ *
+ * Returns the list which should be freed using freeFileList or NULL
+ * if no files were found.
+ */
+char **
+getFileList(const char *path, const char *ext, unsigned int *num)
+{
+    _file_list_t list;
+
+    list.files = NULL;
+    list.num = list.max = 0;
+
+    if (_isDirectory(path))
+    {
+        _addDirectory(&list, path, ext);
+        if (list.num) {
+            qsort(list.files, list.num, sizeof(char*), _compareFiles);
+        }
+    }
+    else {
+        _addFile(&list, NULL, path);
+    }
+
+    *num = list.num;
+    return list.files;
+}
+
+void
+freeFileList(char **files, unsigned int num)
+{
+    unsigned int i;
+
+    for (i=0; i<num; ++i) {
+        free(files[i]);
+    }
+    free(files);
+}
+
 char *strDup(const char *s)
 {
     unsigned int len = strlen(s)+1;
@@ -55,43 +55,48 @@ extern "C" {
 #define SPACE_KEY	0x20
 
 
-#define TRY(a) do { \
-    if (!(a)) printf("Error at line %i: %s\n", __LINE__, aax.strerror()); \
-} while(0)
+#ifdef WIN32
+typedef struct
+{
+    HANDLE m;
+    void *p;
+} SIMPLE_UNMMAP;
+#endif
 
 struct mmap_t {
     int fd;
     size_t len;
     char*start;
 #ifdef WIN32
-    struct {
-        HANDLE m;
-        void *p;
-    } un;
+    SIMPLE_UNMMAP un;
 #else
     int un;                             /* referenced but not used */
 #endif
 };
 
+#define TRY(a) do { \
+    if (!(a)) printf("Error at line %i: %s\n", __LINE__, aax.strerror()); \
+} while(0)
+
 #ifdef WIN32
 #define setenv(a,b,c)	SetEnvironmentVariable((a), (b))
 #define unsetenv(a)	SetEnvironmentVariable((a), NULL)
 
-typedef struct
-{
-    HANDLE m;
-    void *p;
-} SIMPLE_UNMMAP;
-
 void * simple_mmap(int fd, size_t length, SIMPLE_UNMMAP *un);
 void simple_unmmap(void *addr, size_t len, SIMPLE_UNMMAP *un);
+# ifndef MAP_FAILED
+#  define MAP_FAILED	((void*)-1)
+# endif
 #else
+# include <sys/mman.h>
 # define simple_mmap(a, b, c)   mmap(0, (b), PROT_READ, MAP_PRIVATE, (a), 0L)
 # define simple_unmmap(a, b, c) munmap((a), (b))
 #endif
 
 void set_mode(int want_key);
 int get_key();
+int wait_key(float);
+uint64_t getPeakMemoryUsage();
 
 char* getDeviceName(int, char**);
 char* getCaptureName(int, char**);
@@ -100,6 +105,7 @@ char* getInputFile(int, char**, const char*);
 char* getInputFileExt(int, char**, const char*, const char*);
 char* getOutputFile(int, char**, const char*);
 enum aaxFormat getAudioFormat(int, char**, enum aaxFormat);
+enum aaxFormat getFormatFromString(const char*, enum aaxFormat);
 const char* getFormatString(enum aaxFormat format);
 int getNumEmitters(int, char**);
 float getFrequency(int, char**);
@@ -119,6 +125,8 @@ int bufferProcessWaveform(aaxBuffer, float, enum aaxSourceType, float, enum aaxP
 aaxBuffer setFiltersEffects(int, char**, aaxConfig, aaxConfig, aaxFrame, aaxEmitter, const char*);
 int printCopyright(int, char**);
 char* strDup(const char*);
+char** getFileList(const char*, const char*, unsigned int*);
+void freeFileList(char**, unsigned int);
 
 #define testForState(a,b)	testForState_int((a),(b),__LINE__)
 
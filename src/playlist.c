@@ -45,14 +45,115 @@
 
 #define AAX_STREAM_DRIVER	"AeonWave on Audio Files: "
 
-char*
-getURLFromPlaylist(aaxConfig config, const char *playlist)
+#define MIN_ENTRIES		64
+
+/* append an empty entry, growing the entry vector when needed */
+static struct entry_t*
+_playlist_add(struct entry_t **entries, unsigned int *num, unsigned int *max)
 {
-   static const int buf_offs = strlen(AAX_STREAM_DRIVER);
-   static char buf[1025] = AAX_STREAM_DRIVER;
-   const char *ext = strrchr(playlist, '.');
-   char *ptr = strchr(playlist, ':');
-   char *rv = (char*)playlist;
+   struct entry_t *rv = NULL;
+
+   if (*num == *max)
+   {
+      unsigned int max_new = *max ? 2*(*max) : MIN_ENTRIES;
+      struct entry_t *ptr = realloc(*entries, max_new*sizeof(struct entry_t));
+      if (!ptr) return rv;
+
+      *entries = ptr;
+      *max = max_new;
+   }
+
+   rv = &(*entries)[(*num)++];
+   memset(rv, 0, sizeof(struct entry_t));
+   rv->duration = -1.0f;
+
+   return rv;
+}
+
+/* get the next line without its line ending and surrounding white space */
+static const char*
+_playlist_line(const char **text, const char *end, size_t *len)
+{
+   const char *rv = *text;
+   const char *next;
+
+   next = memchr(rv, '\n', end-rv);
+   if (!next) next = end;
+   *text = (next < end) ? next+1 : end;
+
+   while (rv < next && (*rv == ' ' || *rv == '\t')) ++rv;
+   while (next > rv && (next[-1] == '\r' || next[-1] == ' ' ||
+                        next[-1] == '\t')) --next;
+   *len = next - rv;
+
+   return rv;
+}
+
+/* #EXTINF:<duration> [<key>="<value>"]...,<title> */
+static void
+_playlist_extinf(const char *ptr, size_t len, struct entry_t *info)
+{
+   const char *end = ptr+len;
+   int quoted = 0;
+   char *num;
+
+   info->duration = strtof(ptr, &num);
+   if (num == ptr || num > end || info->duration < 0.0f) {
+      info->duration = -1.0f;
+   }
+
+   for (; ptr < end; ++ptr)
+   {
+      if (*ptr == '"') quoted = !quoted;
+      else if (*ptr == ',' && !quoted)
+      {
+         ++ptr;
+         while (ptr < end && *ptr == ' ') ++ptr;
+         if (ptr < end)
+         {
+            info->title = ptr;
+            info->title_len = end-ptr;
+         }
+         break;
+      }
+   }
+}
+
+static char*
+_playlist_copy(char **pool, const char *prefix, const char *str, size_t len)
+{
+   size_t offs = prefix ? strlen(prefix) : 0;
+   char *rv = *pool;
+
+   if (offs) memcpy(rv, prefix, offs);
+   memcpy(rv+offs, str, len);
+   rv[offs+len] = '\0';
+   *pool += offs+len+1;
+
+   return rv;
+}
+
+/**
+ * Get the entries of a playlist, in the order of the playlist or shuffled.
+ * A device name which does not refer to an M3U or PLS playlist results in
+ * a playlist with the device name as its only entry.
+ *
+ * @param config the handle used to read the playlist
+ * @param devname the device name of the playlist
+ * @param shuffle if set the entries are returned in a random order
+ *
+ * Returns NULL on error, otherwise free the playlist using playlistFree.
+ */
+struct playlist_t*
+playlistOpen(aaxConfig config, const char *devname, int shuffle)
+{
+   const char *ext = strrchr(devname, '.');
+   const char *playlist = devname;
+   const char *ptr = strchr(devname, ':');
+   struct playlist_t *rv;
+
+   rv = calloc(1, sizeof(struct playlist_t));
+   if (!rv) return rv;
 
    if (ptr)
    {
@@ -69,105 +170,258 @@ getURLFromPlaylist(aaxConfig config, const char *playlist)
          void **data = aaxBufferGetData(buffer);
          if (data)
          {
-            struct entry_t entries[MAX_ENTRIES];
-            int no_entries = 0;
+            struct entry_t *entries = NULL;
+            const char *text = data[0];
+            size_t len = strlen(text);
+            int i, no_entries = 0;
 
             if (!strcasecmp(ext, ".m3u") || !strcasecmp(ext, ".m3u8")) {
-               no_entries = readM3U(data[0], entries);
+               no_entries = readM3U(text, len, &entries);
             } else if (!strcasecmp(ext, ".pls")) {
-               no_entries = readPLS(data[0], entries);
+               no_entries = readPLS(text, len, &entries);
             }
 
-            // randomly select one from the list
-            if (no_entries)
+            /* all strings are stored in a single block after the items */
+            len = 0;
+            for (i=0; i<no_entries; ++i) {
+               len += strlen(AAX_STREAM_DRIVER)+entries[i].len+1;
+               len += entries[i].title_len+1;
+            }
+
+            if (no_entries > 0)
             {
-               int i, len;
+               size_t size = no_entries*sizeof(struct playlist_item_t);
+               rv->entries = malloc(size+len);
+               if (rv->entries)
+               {
+                  char *pool = (char*)rv->entries + size;
+                  for (i=0; i<no_entries; ++i)
+                  {
+                     struct playlist_item_t *item = &rv->entries[i];
 
-               srand(time(NULL));
-               i = rand() % no_entries;
-               len = entries[i].len;
-               if (len > 1024-buf_offs) {
-                  len = 1024-buf_offs;
+                     item->devname = _playlist_copy(&pool, AAX_STREAM_DRIVER,
+                                                entries[i].url, entries[i].len);
+                     item->title = NULL;
+                     if (entries[i].title) {
+                        item->title = _playlist_copy(&pool, NULL,
+                                        entries[i].title, entries[i].title_len);
+                     }
+                     item->duration = entries[i].duration;
+                  }
+                  rv->num = no_entries;
                }
-               memcpy(buf+buf_offs, entries[i].url, len);
-               buf[1024] = '\0';
-               rv = buf;
             }
-
+            free(entries);
             aaxFree(data);
          }
+         aaxBufferDestroy(buffer);
+      }
+   }
+   else
+   {
+      size_t size = sizeof(struct playlist_item_t);
+      size_t len = strlen(devname);
+
+      rv->entries = malloc(size+len+1);
+      if (rv->entries)
+      {
+         char *pool = (char*)rv->entries + size;
+
+         rv->entries[0].devname = _playlist_copy(&pool, NULL, devname, len);
+         rv->entries[0].title = NULL;
+         rv->entries[0].duration = -1.0f;
+         rv->num = 1;
       }
    }
 
+   /* Fisher-Yates */
+   if (shuffle && rv->num > 1)
+   {
+      unsigned int i;
+
+      srand(time(NULL));
+      for (i=rv->num-1; i>0; --i)
+      {
+         unsigned int j = rand() % (i+1);
+         struct playlist_item_t tmp = rv->entries[i];
+
+         rv->entries[i] = rv->entries[j];
+         rv->entries[j] = tmp;
+      }
+   }
+
+   if (!rv->num)
+   {
+      playlistFree(rv);
+      rv = NULL;
+   }
+
    return rv;
 }
 
+void
+playlistFree(struct playlist_t *playlist)
+{
+   if (playlist)
+   {
+      free(playlist->entries);
+      free(playlist);
+   }
+}
+
+/**
+ * Parse an (extended) M3U playlist in a single pass. The entries are views
+ * into the playlist text, which has to stay available while they are used.
+ * The duration and title of an #EXTINF tag are set for the entry which
+ * follows it.
+ *
+ * @param pls the playlist text
+ * @param len the length of the playlist text in bytes
+ * @param entries receives the entries, free them using free()
+ *
+ * Returns the number of entries or -1 on error.
+ */
 int
-readM3U(const char *pls, struct entry_t entries[MAX_ENTRIES])
+readM3U(const char *pls, size_t len, struct entry_t **entries)
 {
-   int rv = 0;
-   if (pls)
+   unsigned int num = 0, max = 0;
+   const char *end = pls+len;
+   struct entry_t info;
+
+   *entries = NULL;
+   if (!pls) return 0;
+
+   /* UTF-8 byte order mark */
+   if (len >= 3 && !memcmp(pls, "\xEF\xBB\xBF", 3)) pls += 3;
+
+   memset(&info, 0, sizeof(info));
+   info.duration = -1.0f;
+   while (pls < end)
    {
-      size_t len = strlen(pls);
-      int no_urls = 0;
+      const char *line = _playlist_line(&pls, end, &len);
 
-      while (len > 1 && no_urls < MAX_ENTRIES)
+      if (!len) continue;
+      if (*line == '#')
       {
-         const char *next = strstr(pls+1, "\r\n");
-         if (!next) next = strchr(pls+1, '\n');
-         if (!next) next = pls+strlen(pls);
-
-         if (*pls != '#')
+         if (len > 8 && !strncasecmp(line, "#EXTINF:", 8)) {
+            _playlist_extinf(line+8, len-8, &info);
+         }
+      }
+      else
+      {
+         struct entry_t *entry = _playlist_add(entries, &num, &max);
+         if (!entry)
          {
-            entries[no_urls].url = (char*)pls;
-            entries[no_urls++].len = next - pls;
+            free(*entries);
+            *entries = NULL;
+            return -1;
          }
 
-         if (*next == '\r') ++next;
-         if (*next == '\n') ++next;
+         entry->url = line;
+         entry->len = len;
+         entry->duration = info.duration;
+         entry->title = info.title;
+         entry->title_len = info.title_len;
 
-         len -= next-pls;
-         pls = next;
+         memset(&info, 0, sizeof(info));
+         info.duration = -1.0f;
       }
-      rv = no_urls;
    }
 
-   return rv;
+   return num;
 }
 
+/**
+ * Parse a PLS playlist in a single pass. The FileN, TitleN and LengthN keys
+ * with the same number are combined into one entry, entries without a file
+ * are dropped. The entries are views into the playlist text.
+ *
+ * @param pls the playlist text
+ * @param len the length of the playlist text in bytes
+ * @param entries receives the entries, free them using free()
+ *
+ * Returns the number of entries or -1 on error.
+ */
 int
-readPLS(const char *pls, struct entry_t entries[MAX_ENTRIES])
+readPLS(const char *pls, size_t len, struct entry_t **entries)
 {
-   int rv = 0;
+   unsigned int i, num = 0, max = 0;
+   const char *end = pls+len;
+
+   *entries = NULL;
+   if (!pls) return 0;
 
-   if (pls)
+   while (pls < end)
    {
-      size_t len = strlen(pls);
-      int no_urls = 0;
+      const char *line = _playlist_line(&pls, end, &len);
+      const char *key_end = memchr(line, '=', len);
+      struct entry_t *entry = NULL;
+      const char *value;
+      unsigned long no;
+      size_t key_len;
+      int key;
+      char *ptr;
 
-      while (len > sizeof("FileXX=") && no_urls < MAX_ENTRIES)
-      {
-         const char *next = strchr(pls+1, '\n');
-         if (!next) next = pls+strlen(pls);
-         else next++;
+      if (!key_end) continue;
+
+      if (len > 4 && !strncasecmp(line, "File", 4)) key = 'F';
+      else if (len > 5 && !strncasecmp(line, "Title", 5)) key = 'T';
+      else if (len > 6 && !strncasecmp(line, "Length", 6)) key = 'L';
+      else continue;
+
+      key_len = (key == 'F') ? 4 : (key == 'T') ? 5 : 6;
+      no = strtoul(line+key_len, &ptr, 10);
+      if (ptr != key_end) continue;
 
-         if (!strncasecmp(pls, "File", strlen("File")))
+      /* entries are usually numbered from one and their keys grouped */
+      if (no >= 1 && no <= num && (*entries)[no-1].no == no) {
+         entry = &(*entries)[no-1];
+      } else if (num && (*entries)[num-1].no == no) {
+         entry = &(*entries)[num-1];
+      }
+
+      if (!entry)
+      {
+         entry = _playlist_add(entries, &num, &max);
+         if (!entry)
          {
-            char *start = strchr(pls, '=');
-            if (start)
-            {
-               entries[no_urls].url = ++start;
-               entries[no_urls++].len = next - start - 1;
-            }
+            free(*entries);
+            *entries = NULL;
+            return -1;
          }
+         entry->no = no;
+      }
 
-         len -= next-pls;
-         pls = next;
+      value = key_end+1;
+      while (value < line+len && *value == ' ') ++value;
+      switch (key)
+      {
+      case 'F':
+         entry->url = value;
+         entry->len = line+len - value;
+         break;
+      case 'T':
+         entry->title = value;
+         entry->title_len = line+len - value;
+         break;
+      case 'L':
+         entry->duration = strtof(value, &ptr);
+         if (ptr == value || ptr > line+len || entry->duration < 0.0f) {
+            entry->duration = -1.0f;
+         }
+         break;
+      default:
+         break;
       }
-      rv = no_urls;
    }
 
-   return rv;
-}
-
+   /* remove entries without a file */
+   for (i=max=0; i<num; ++i)
+   {
+      if ((*entries)[i].url && (*entries)[i].len) {
+         (*entries)[max++] = (*entries)[i];
+      }
+   }
 
+   return max;
+}
@@ -36,15 +36,32 @@
 extern "C" {
 #endif
 
-#define MAX_ENTRIES	16
+/* a playlist entry as a view into the playlist text, see readM3U */
 struct entry_t {
-   char *url;
+   const char *url;
    size_t len;
+   const char *title;		/* NULL if not available */
+   size_t title_len;
+   float duration;		/* in seconds, negative if unknown */
+   unsigned long no;		/* the PLS entry number */
 };
 
-char* getURLFromPlaylist(aaxConfig, const char*);
-int readM3U(const char*, struct entry_t[MAX_ENTRIES]);
-int readPLS(const char*, struct entry_t[MAX_ENTRIES]);
+struct playlist_item_t {
+   char *devname;		/* the device name to open the entry with */
+   char *title;			/* NULL if not available */
+   float duration;		/* in seconds, negative if unknown */
+};
+
+/* the entries of a playlist */
+struct playlist_t {
+   struct playlist_item_t *entries;
+   unsigned int num;
+};
+
+struct playlist_t* playlistOpen(aaxConfig, const char*, int);
+void playlistFree(struct playlist_t*);
+int readM3U(const char*, size_t, struct entry_t**);
+int readPLS(const char*, size_t, struct entry_t**);
 
 #if defined(__cplusplus)
 }
@@ -37,15 +37,20 @@
 #ifdef _WIN32
 # include <io.h>
 #endif
+#include <sys/stat.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <string.h>
+#include <limits.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 
 #include <aax/aax.h>
 #include <base/types.h>
+#include <base/threads.h>
+#include <base/interleave.h>
 
 #include "driver.h"
 #include "wavfile.h"
@@ -60,7 +65,6 @@
 # define O_BINARY		0
 #endif
 
-static uint32_t _oalSoftwareWaveHeader[WAVE_EXT_HEADER_SIZE];
 #if 0
 static const uint32_t _defaultWaveHeader[WAVE_EXT_HEADER_SIZE] =
 {
@@ -87,18 +91,483 @@ static const uint32_t _defaultWaveHeader[WAVE_EXT_HEADER_SIZE] =
 };
 #endif
 
-#define DEBUG_PRINT(a) \
-    printf(" %2i: %08x \"%c%c%c%c\"\n", a, _oalSoftwareWaveHeader[a], \
-             p[4*a], p[4*a+1], p[4*a+2], p[4*a+3]);
+#define WAV_PROBE_SIZE		4096
+#define RIFF_HEADER_SIZE	12
+#define RIFF_CHUNK_HEADER_SIZE	8
+#define RIFF_CHUNK_RIFF		0x46464952	/* "RIFF" */
+#define RIFF_CHUNK_RF64		0x34364652	/* "RF64" */
+#define RIFF_CHUNK_BW64		0x34365742	/* "BW64" */
+#define RIFF_CHUNK_DS64		0x34367364	/* "ds64" */
+#define RIFF_CHUNK_WAVE		0x45564157	/* "WAVE" */
+#define RIFF_CHUNK_FMT		0x20746d66	/* "fmt " */
+#define RIFF_CHUNK_DATA		0x61746164	/* "data" */
+#define RIFF_CHUNK_JUNK		0x4b4e554a	/* "JUNK" */
 
-#define BSWAP16(x)	(x >> 8) | (x << 8)
-#define BSWAP32H(x)	((x >> 8) & 0x00FF00FFL) | ((x << 8) & 0xFF00FF00L)
-#define BSWAP32W(x)	(x >> 16) | (x << 16)
-#define BSWAP32(x)	BSWAP32W(BSWAP32H(x))
 
+/*
+ * RIFF chunk iterator which works on an open file descriptor or on a block
+ * of memory. Only the chunk headers are read, chunk bodies are skipped by
+ * seeking over them.
+ */
+typedef struct
+{
+    int fd;			/* file descriptor when data == NULL */
+    const uint8_t *head;	/* optional copy of the start of the file */
+    size_t head_len;
+    const uint8_t *data;	/* start of the RIFF data in memory */
+    uint64_t size;		/* size of the file or the memory block */
+    uint64_t next;		/* offset of the next chunk header */
+    uint64_t ds64_data_size;	/* RF64: 64-bit size of the data chunk */
+} _riff_iter_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t size;		/* size of the chunk body in bytes */
+    uint64_t offset;		/* offset of the chunk body */
+} _riff_chunk_t;
+
+
+static inline uint16_t
+_get_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t
+_get_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+_get_le64(const uint8_t *p) {
+    return _get_le32(p) | ((uint64_t)_get_le32(p+4) << 32);
+}
+
+static inline void
+_put_le16(uint8_t *p, uint16_t v) {
+    p[0] = v; p[1] = v >> 8;
+}
+
+static inline void
+_put_le32(uint8_t *p, uint32_t v) {
+    _put_le16(p, v); _put_le16(p+2, v >> 16);
+}
+
+static inline void
+_put_le64(uint8_t *p, uint64_t v) {
+    _put_le32(p, v); _put_le32(p+4, v >> 32);
+}
+
+static int
+_riff_read(_riff_iter_t *it, uint64_t offset, void *buf, size_t len)
+{
+    int rv = 0;
+
+    if (offset <= it->size && len <= it->size - offset)
+    {
+        if (it->data)
+        {
+            memcpy(buf, it->data+offset, len);
+            rv = 1;
+        }
+        else if (offset + len <= it->head_len)
+        {
+            memcpy(buf, it->head+offset, len);
+            rv = 1;
+        }
+        else if (lseek(it->fd, (off_t)offset, SEEK_SET) == (off_t)offset) {
+            rv = (read(it->fd, buf, len) == (ssize_t)len);
+        }
+    }
+    return rv;
+}
+
+/*
+ * Check for a RIFF/WAVE (or 64-bit RF64 and BW64) header and position the
+ * iterator at the first chunk.
+ */
+static int
+_riff_begin(_riff_iter_t *it)
+{
+    uint8_t hdr[RIFF_HEADER_SIZE];
+    int rv = 0;
+
+    it->ds64_data_size = 0;
+    if (_riff_read(it, 0, hdr, RIFF_HEADER_SIZE) &&
+        _get_le32(hdr+8) == RIFF_CHUNK_WAVE)
+    {
+        switch (_get_le32(hdr))
+        {
+        case RIFF_CHUNK_RIFF:
+        case RIFF_CHUNK_RF64:
+        case RIFF_CHUNK_BW64:
+            it->next = RIFF_HEADER_SIZE;
+            rv = 1;
+            break;
+        default:
+            break;
+        }
+    }
+    return rv;
+}
+
+static int
+_riff_next(_riff_iter_t *it, _riff_chunk_t *chunk)
+{
+    uint8_t hdr[RIFF_CHUNK_HEADER_SIZE];
+    int rv = 0;
+
+    if (_riff_read(it, it->next, hdr, RIFF_CHUNK_HEADER_SIZE))
+    {
+        chunk->id = _get_le32(hdr);
+        chunk->size = _get_le32(hdr+4);
+        chunk->offset = it->next + RIFF_CHUNK_HEADER_SIZE;
+
+        /* chunks are word aligned, a truncated chunk ends the iteration */
+        if (chunk->size < it->size - chunk->offset) {
+            it->next = chunk->offset + chunk->size + (chunk->size & 1);
+        } else {
+            it->next = it->size;
+        }
+#if PRINT_DEBUG_MSG
+        printf(" chunk \"%c%c%c%c\": %u bytes at offset %lu\n",
+               hdr[0], hdr[1], hdr[2], hdr[3], chunk->size,
+               (unsigned long)chunk->offset);
+#endif
+        rv = 1;
+    }
+    return rv;
+}
+
+static int
+_wav_read_fmt(_riff_iter_t *it, _riff_chunk_t *chunk, struct wavinfo_t *fmt)
+{
+    uint8_t buf[40];
+    size_t len = _MIN(chunk->size, sizeof(buf));
+    int rv = 0;
+
+    if (len >= 16 && _riff_read(it, chunk->offset, buf, len))
+    {
+        fmt->format = _get_le16(buf);
+        fmt->no_tracks = _get_le16(buf+2);
+        fmt->freq = _get_le32(buf+4);
+        fmt->block = _get_le16(buf+12);
+        fmt->bits_sample = _get_le16(buf+14);
+
+        // EXTENSIBLE_WAVE_FORMAT: the format is stored in the sub-format GUID
+        if (fmt->format == 0xFFFE && len >= 26) {
+            fmt->format = _get_le16(buf+24);
+        }
+        rv = 1;
+    }
+    return rv;
+}
+
+/*
+ * Walk the chunks of a WAVE file up to the data chunk.
+ * Returns AAX_TRUE if both the fmt and the data chunk are found.
+ */
+static int
+_wav_parse(_riff_iter_t *it, struct wavinfo_t *fmt)
+{
+    _riff_chunk_t chunk;
+    int have_fmt = 0;
+    int rv = 0;
+
+    memset(fmt, 0, sizeof(struct wavinfo_t));
+    if (_riff_begin(it))
+    {
+        while (!rv && _riff_next(it, &chunk))
+        {
+            switch (chunk.id)
+            {
+            case RIFF_CHUNK_DS64:
+            {
+                uint8_t buf[16];	/* RIFF size and data size */
+                if (chunk.size >= 16 && _riff_read(it, chunk.offset, buf, 16)) {
+                    it->ds64_data_size = _get_le64(buf+8);
+                }
+                break;
+            }
+            case RIFF_CHUNK_FMT:
+                have_fmt = _wav_read_fmt(it, &chunk, fmt);
+                break;
+            case RIFF_CHUNK_DATA:
+                if (have_fmt && fmt->no_tracks && fmt->bits_sample)
+                {
+                    uint64_t size = chunk.size;
+
+                    if (size == 0xFFFFFFFF && it->ds64_data_size) {
+                        size = it->ds64_data_size;
+                    }
+                    fmt->data_offset = chunk.offset;
+                    fmt->data_size = _MIN(size, it->size - chunk.offset);
+                    fmt->no_samples = (fmt->data_size*8)/
+                                      (fmt->no_tracks*fmt->bits_sample);
+                    rv = 1;
+                }
+                else {
+                    it->next = it->size;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return rv;
+}
+
+static void
+_wav_get_info(const struct wavinfo_t *info, unsigned int *no_samples,
+#if !_OPENAL_SUPPORT
+              unsigned *block,
+#endif
+              int *freq, char *bits_sample, char *no_tracks,
+              unsigned int *format)
+{
+    *no_samples = info->no_samples;
+#if !_OPENAL_SUPPORT
+    *block = info->block;
+#endif
+    *freq = info->freq;
+    *bits_sample = info->bits_sample;
+    *no_tracks = info->no_tracks;
+    *format = info->format;
+}
+
+#if PRINT_INFO_MSG
+static void
+_wav_print_info(const char *file, const struct wavinfo_t *info)
+{
+    uint64_t buflen = info->data_size;
+    float duration;
+
+    printf("Audio file: %s\n", file);
+    if (buflen < 10240)
+        printf("Size:\t\t\t%" PRIu64 " bytes\n", buflen);
+    else
+        printf("Size:\t\t\t%" PRIu64 " kb (%" PRIu64 " bytes)\n",
+               buflen / 1024, buflen);
+    printf("Sample rate:\t\t%i kHz\n", info->freq / 1000);
+    printf("No. tracks:\t\t%i\n", info->no_tracks);
+    printf("Bits per sample:\t%i\n", info->bits_sample);
+
+    printf("Data format:\t\t");
+    switch (info->format)
+    {
+    case 1:
+        printf("PCM\n");
+        break;
+    case 2:
+        printf("Microsoft ADPCM\n");
+        break;
+    case 3:
+        printf("PCM Floating point\n");
+        break;
+    case 6:
+        printf("G.711 a-law\n");
+        break;
+    case 7:
+        printf("G.711 mulaw\n");
+        break;
+    case 17:
+        printf("IMA4 ADPCM\n");
+        break;
+    default:
+        printf("unknown (0x%X)\n", info->format);
+    }
+
+    printf("Samples per block:\t%i\n", info->block);
+    printf("No. samples:\t\t%" PRIu64 "\n", info->no_samples);
+
+    duration = (float)(buflen * 8);
+    duration /= (info->freq * info->no_tracks * info->bits_sample);
+    printf("Duration:\t\t%5.3f sec.\n", duration);
+}
+#endif
+
+/**
+ * Read the format information of a WAVE file without reading the audio
+ * data. The first few kilobytes of the file are read at once, the chunks
+ * after that (if any) are located by seeking over them.
+ *
+ * @param a pointer to the exact ascii file location
+ * @param info the returned audio format and data chunk information, the
+ *        duration in seconds is info->no_samples/info->freq
+ * @param file_size the returned size of the file in bytes (optional)
+ *
+ * Returns 0 on success, the errno value if the file could not be opened
+ * or -1 if it is not a supported WAVE file.
+ */
+int
+fileProbe(const char *file, struct wavinfo_t *info, uint64_t *file_size)
+{
+    uint8_t head[WAV_PROBE_SIZE];
+    _riff_iter_t it;
+    struct stat st;
+    ssize_t len;
+    int fd, rv;
+
+    memset(info, 0, sizeof(struct wavinfo_t));
+
+    fd = open(file, O_RDONLY|O_BINARY);
+    if (fd < 0) return errno;
+
+    len = read(fd, head, sizeof(head));
 
-static char __big_endian = 0;
-static void bufferConvertMSIMA_IMA4(void*, unsigned, unsigned int, unsigned*);
+    it.fd = fd;
+    it.data = NULL;
+    it.head = head;
+    it.head_len = (len > 0) ? len : 0;
+    it.size = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    rv = _wav_parse(&it, info) ? 0 : -1;
+    close(fd);
+
+    if (file_size) *file_size = it.size;
+
+    return rv;
+}
+
+/* the number of samples per track in a block of MS-IMA ADPCM data */
+static unsigned int
+_wav_ima4_block_samples(const struct wavinfo_t *info)
+{
+    unsigned int header = 4*info->no_tracks;
+
+    if (!info->no_tracks || info->block <= header) return 0;
+    return (info->block - header)*2/info->no_tracks + 1;
+}
+
+/**
+ * Limit the audio data of a WAVE file to a range of samples so only that
+ * part of the data chunk has to be read. The data offset, data size and
+ * number of samples of info are updated. For IMA4 ADPCM the range is
+ * extended to whole blocks.
+ *
+ * @param info the audio format and data chunk information of the file
+ * @param start the first sample per track of the range
+ * @param length the number of samples per track, 0 for up to the end
+ *
+ * Returns the first sample of the range, which is before start when the
+ * range had to be aligned to a block.
+ */
+uint64_t
+wavInfoSetRange(struct wavinfo_t *info, uint64_t start, uint64_t length)
+{
+    uint64_t block_samples = 1, num_blocks, first, last;
+
+    if (!info->block || !info->no_tracks || !info->bits_sample) return 0;
+
+    if (info->format == 0x11)
+    {
+        block_samples = _wav_ima4_block_samples(info);
+        if (!block_samples) return 0;
+    }
+
+    /* a partial block at the end still holds samples */
+    num_blocks = (info->data_size + info->block-1)/info->block;
+    first = _MIN(start/block_samples, num_blocks);
+    last = num_blocks;
+    if (length && start+length > start) {
+        last = (start+length + block_samples-1)/block_samples;
+    }
+    last = _MIN(_MAX(last, first), num_blocks);
+
+    info->data_offset += first*info->block;
+    info->data_size = _MIN((last-first)*info->block,
+                           info->data_size - first*info->block);
+
+    /*
+     * The same sample count convention as _wav_parse, which is what
+     * aaxBufferCreate and bufferCopyMSIMA_IMA4 expect for IMA4 data.
+     */
+    info->no_samples = (info->data_size*8)/(info->no_tracks*info->bits_sample);
+
+    return first*block_samples;
+}
+
+/**
+ * Load a canonical WAVE file into memory and return a pointer to the buffer.
+ * All state is kept in the caller supplied info structure which makes it
+ * safe to load files from multiple threads at the same time.
+ *
+ * @param a pointer to the exact ascii file location
+ * @param info the returned audio format and data chunk information
+ */
+void *
+fileLoadInfo(const char *file, struct wavinfo_t *info)
+{
+    _riff_iter_t it;
+    struct stat st;
+    void *data = NULL;
+    int fd;
+
+    memset(info, 0, sizeof(struct wavinfo_t));
+
+    fd = open(file, O_RDONLY|O_BINARY);
+    if (fd < 0) return data;
+
+    it.fd = fd;
+    it.data = NULL;
+    it.head_len = 0;
+    it.size = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    if (_wav_parse(&it, info) && info->data_size <= (size_t)-1)
+    {
+        size_t buflen = info->data_size;
+        size_t pos = 0;
+
+        /* a single read() returns at most about 2GB on Linux */
+        data = malloc(buflen);
+        if (data && lseek(fd, (off_t)info->data_offset, SEEK_SET) >= 0)
+        {
+            while (pos < buflen)
+            {
+                ssize_t res = read(fd, (uint8_t*)data+pos, buflen-pos);
+                if (res > 0) pos += res;
+                else if (res == 0 || errno != EINTR) break;
+            }
+        }
+
+        if (data && pos < buflen)
+        {
+            free(data);
+            data = NULL;
+        }
+
+        if (data)
+        {
+#if _OPENAL_SUPPORT
+            /* OpenAL only, AeonWave does the conversion for us */
+            static const unsigned int _t = 1;
+            char big_endian = (*(char *)&_t == 0);
+            if (big_endian && (info->bits_sample > 8))
+            {
+                switch (info->bits_sample)
+                {
+                case 16:
+                    _bswap16_array(data, data, buflen/2);
+                    break;
+                case 24:
+                    _bswap24_array(data, data, buflen/3);
+                    break;
+                case 32:
+                    _bswap32_array(data, data, buflen/4);
+                    break;
+                case 64:
+                    _bswap64_array(data, data, buflen/8);
+                    break;
+                default:
+                    break;
+                }
+            }
+#endif
+        }
+    }
+    close(fd);
+
+    return data;
+}
 
 /**
  * Load a canonical WAVE file into memory and return a pointer to the buffer.
@@ -116,333 +585,989 @@ fileLoad(const char *file, unsigned int *no_samples,
 #endif
          int *freq, char *bits_sample, char *no_tracks, unsigned int *format)
 {
-    static const unsigned int _t = 1;
-    unsigned int buflen, blocksz = 1;
-    char buf[4];
+    struct wavinfo_t info;
+    void *data;
+
+#if !_OPENAL_SUPPORT
+    *block = 1;
+#endif
+
+    data = fileLoadInfo(file, &info);
+    if (data)
+    {
+        _wav_get_info(&info, no_samples,
+#if !_OPENAL_SUPPORT
+                      block,
+#endif
+                      freq, bits_sample, no_tracks, format);
+#if PRINT_INFO_MSG
+        _wav_print_info(file, &info);
+#endif
+    }
+
+    return data;
+}
+
+
+/*
+ * The library stream reader also handles compressed formats and the sample
+ * loop and release information of a WAVE file, which the mapped path does
+ * not parse. Use bufferFromFileMapped for plain audio data.
+ */
+aaxBuffer
+bufferFromFile(aaxConfig config, const char *infile)
+{
+#if 1
+   return aaxBufferReadFromStream(config, infile);
+#else
+    aaxBuffer buffer = NULL;
+    unsigned int fmt, no_samples;
+    enum aaxFormat format;
+    char bps, channels;
+    unsigned block = 1;
+    int res, freq;
+    void *data;
+
+    data = fileLoad(infile, &no_samples,
+#if !_OPENAL_SUPPORT
+                    &block,
+#endif
+                    &freq, &bps, &channels, &fmt);
+    format = getFormatFromFileFormat(fmt, bps);
+    if (data && format != AAX_FORMAT_NONE)
+    {
+        buffer = aaxBufferCreate(config, no_samples, channels, format);
+
+        if (format == AAX_IMA4_ADPCM)
+        {
+            bufferConvertMSIMA_IMA4(data, channels, no_samples, &block);
+
+            res = aaxBufferSetSetup(buffer, AAX_BLOCK_ALIGNMENT, block);
+            testForState(res, "aaxBufferSetSetup(AAX_BLOCK_ALIGNMENT)");
+        }
+
+        res = aaxBufferSetSetup(buffer, AAX_FREQUENCY, freq);
+        testForState(res, "aaxBufferSetSetup(AAX_FREQUENCY)");
+
+        res = aaxBufferSetData(buffer, data);
+        testForState(res, "aaxBufferSetData");
+    }
+    free(data);
+
+    return buffer;
+#endif
+}
+
+
+/**
+ * process a canonical WAVE file in memory and return a pointer to the
+ * audio data. All state is kept in the caller supplied info structure.
+ *
+ * @param a pointer to the wave file buffer
+ * @param info the returned audio format and data chunk information
+ */
+void*
+dataLoadInfo(const unsigned char *data, struct wavinfo_t *info)
+{
+    /* the size of the blob is not known, the RIFF chunk size is used */
+    return dataLoadInfoSize(data, (size_t)-1, info);
+}
+
+/**
+ * Like dataLoadInfo but no data beyond the size bytes of the blob will be
+ * accessed, regardless of the sizes stored in the file.
+ *
+ * @param a pointer to the wave file buffer
+ * @param size the size of the wave file buffer in bytes
+ * @param info the returned audio format and data chunk information
+ */
+void*
+dataLoadInfoSize(const void *blob, size_t size, struct wavinfo_t *info)
+{
+    const uint8_t *data = (const uint8_t*)blob;
+    _riff_iter_t it;
+    void *rv = NULL;
+
+    memset(info, 0, sizeof(struct wavinfo_t));
+
+    it.fd = -1;
+    it.data = data;
+    it.size = _MIN(size, RIFF_HEADER_SIZE);
+    if (_riff_begin(&it))
+    {
+        uint64_t riff_size = _get_le32(data+4);
+
+        it.size = _MIN(size, riff_size + RIFF_CHUNK_HEADER_SIZE);
+        if (_wav_parse(&it, info)) {
+            rv = (void*)(data + info->data_offset);
+        }
+    }
+
+    return rv;
+}
+
+/**
+ * process a canonical WAVE file in memory and return a pointer to the buffer.
+ *
+ * @param a pointer to the wave file buffer
+ * @ve file param no_samples the returned number of samples per audio track
+ * @param freq the returned sample frequency of the audio tracks
+ * @param bits_sample the returned number of bits per sample
+ * @param no_tracks the returned number of audio tracks in the buffer
+ */
+void*
+dataLoad(const unsigned char *data, unsigned int *no_samples,
+#if !_OPENAL_SUPPORT
+         unsigned *block,
+#endif
+         int *freq, char *bits_sample, char *no_tracks, unsigned int *format)
+{
+    struct wavinfo_t info;
+    void *rv;
+
+#if !_OPENAL_SUPPORT
+    *block = 1;
+#endif
+
+    rv = dataLoadInfo(data, &info);
+    if (rv)
+    {
+        _wav_get_info(&info, no_samples,
+#if !_OPENAL_SUPPORT
+                      block,
+#endif
+                      freq, bits_sample, no_tracks, format);
+    }
+
+    return rv;
+}
+
+
+/*
+ * Create a buffer from the parsed audio data. aaxBufferSetData copies the
+ * data into the library, so the source may be read-only and can be
+ * released afterwards. Multi-channel IMA4 data needs rewriting first and
+ * goes through one more temporary copy. Returns NULL on error.
+ */
+static aaxBuffer
+_bufferFromWaveData(aaxConfig config, const void *data,
+                    const struct wavinfo_t *info)
+{
+    enum aaxFormat format;
+    aaxBuffer buffer = NULL;
+
+    format = getFormatFromFileFormat(info->format, info->bits_sample);
+    if (format != AAX_FORMAT_NONE && info->no_samples <= UINT_MAX &&
+        info->data_size <= (size_t)-1)
+    {
+        unsigned int block = info->block;
+        const void *ptr = data;
+        void *copy = NULL;
+        int res;
+
+        buffer = aaxBufferCreate(config, info->no_samples, info->no_tracks,
+                                 format);
+        if (buffer && format == AAX_IMA4_ADPCM && info->no_tracks > 1)
+        {
+            ptr = copy = malloc(info->data_size);
+            if (copy) {
+                bufferCopyMSIMA_IMA4(copy, data, info->no_tracks,
+                                     info->no_samples, &block);
+            }
+        }
+
+        res = (buffer && ptr) ? AAX_TRUE : AAX_FALSE;
+        if (res && format == AAX_IMA4_ADPCM) {
+            res = aaxBufferSetSetup(buffer, AAX_BLOCK_ALIGNMENT, block);
+        }
+        if (res) {
+            res = aaxBufferSetSetup(buffer, AAX_FREQUENCY, info->freq);
+        }
+        if (res) {
+            res = aaxBufferSetData(buffer, ptr);
+        }
+
+        if (!res && buffer)
+        {
+            aaxBufferDestroy(buffer);
+            buffer = NULL;
+        }
+        free(copy);
+    }
+
+    return buffer;
+}
+
+/*
+ * Create a buffer from a WAVE file compiled into the binary. The size of
+ * the blob is taken from the RIFF header, use bufferFromBlob when the size
+ * is known.
+ */
+aaxBuffer
+bufferFromData(aaxConfig config, const unsigned char *indata)
+{
+    return bufferFromBlob(config, indata, (size_t)-1);
+}
+
+/**
+ * Create a buffer from a WAVE file in (read-only) memory. The chunks are
+ * never read beyond size bytes, whatever sizes they claim. The audio data
+ * is copied into the library by aaxBufferSetData, no other copy is made
+ * except for multi-channel IMA4 which needs rewriting.
+ *
+ * @param config the handle to the driver used to create the buffer
+ * @param blob a pointer to the start of the WAVE file in memory
+ * @param size the size of the blob in bytes
+ *
+ * Returns NULL if the blob is not a valid WAVE file or could not be loaded.
+ */
+aaxBuffer
+bufferFromBlob(aaxConfig config, const void *blob, size_t size)
+{
+    aaxBuffer buffer = NULL;
+    struct wavinfo_t info;
+    void *data;
+
+    data = dataLoadInfoSize(blob, size, &info);
+    if (data) {
+        buffer = _bufferFromWaveData(config, data, &info);
+    }
+
+    return buffer;
+}
+
+
+/**
+ * Map a canonical WAVE file read-only into memory and return a pointer to
+ * the start of the audio data inside the mapping. The mapping stays valid
+ * until fileUnmap is called.
+ *
+ * @param a pointer to the exact ascii file location
+ * @param map the returned mapping information, required for fileUnmap
+ * @param info the returned audio format and data chunk information
+ */
+void *
+fileMapInfo(const char *file, struct mmap_t *map, struct wavinfo_t *info)
+{
+    void *data = NULL;
+    struct stat st;
+
+    memset(info, 0, sizeof(struct wavinfo_t));
+    memset(map, 0, sizeof(struct mmap_t));
+    map->start = MAP_FAILED;
+
+    map->fd = open(file, O_RDONLY|O_BINARY);
+    if (map->fd < 0) return data;
+
+    if (fstat(map->fd, &st) == 0 && st.st_size > RIFF_HEADER_SIZE)
+    {
+        map->len = st.st_size;
+        map->start = simple_mmap(map->fd, map->len, &map->un);
+        if (map->start != MAP_FAILED)
+        {
+            _riff_iter_t it;
+
+#ifdef POSIX_MADV_SEQUENTIAL
+            posix_madvise(map->start, map->len, POSIX_MADV_SEQUENTIAL);
+#endif
+            it.fd = -1;
+            it.data = (const uint8_t*)map->start;
+            it.size = map->len;
+            if (_wav_parse(&it, info)) {
+                data = map->start + info->data_offset;
+            }
+        }
+    }
+
+    if (!data) fileUnmap(map);
+
+    return data;
+}
+
+/**
+ * Map a canonical WAVE file read-only into memory and return a pointer to
+ * the start of the audio data inside the mapping. The mapping stays valid
+ * until fileUnmap is called.
+ *
+ * @param a pointer to the exact ascii file location
+ * @param map the returned mapping information, required for fileUnmap
+ * @param no_samples the returned number of samples per audio track
+ * @param freq the returned sample frequency of the audio tracks
+ * @param bits_sample the returned number of bits per sample
+ * @param no_tracks the returned number of audio tracks in the buffer
+ */
+void *
+fileMap(const char *file, struct mmap_t *map, unsigned int *no_samples,
+#if !_OPENAL_SUPPORT
+        unsigned *block,
+#endif
+        int *freq, char *bits_sample, char *no_tracks, unsigned int *format)
+{
+    struct wavinfo_t info;
     void *data;
-    int i, fd;
-    int res;
 
 #if !_OPENAL_SUPPORT
     *block = 1;
 #endif
 
-    __big_endian = (*(char *)&_t == 0);
+    data = fileMapInfo(file, map, &info);
+    if (data)
+    {
+        _wav_get_info(&info, no_samples,
+#if !_OPENAL_SUPPORT
+                      block,
+#endif
+                      freq, bits_sample, no_tracks, format);
+    }
+
+    return data;
+}
+
+void
+fileUnmap(struct mmap_t *map)
+{
+    if (map->start != MAP_FAILED) {
+        simple_unmmap(map->start, map->len, &map->un);
+    }
+    if (map->fd >= 0) {
+        close(map->fd);
+    }
+    map->start = MAP_FAILED;
+    map->fd = -1;
+}
+
+/*
+ * Like bufferFromFile but reads the audio data from a read-only mapping of
+ * the file, which saves the intermediate malloc and read of the data
+ * chunk. aaxBufferSetData always copies the data into the storage of the
+ * library, so the data is still copied once; the buffer API offers no way
+ * to avoid that. Multi-channel IMA4 needs rewriting and gets one more
+ * temporary copy. Files which can not be mapped are passed on to
+ * bufferFromFile. Returns NULL on error instead of terminating the program.
+ */
+aaxBuffer
+bufferFromFileMapped(aaxConfig config, const char *infile)
+{
+    aaxBuffer buffer = NULL;
+    struct wavinfo_t info;
+    struct mmap_t map;
+    void *data;
+
+    data = fileMapInfo(infile, &map, &info);
+    if (data)
+    {
+        buffer = _bufferFromWaveData(config, data, &info);
+        fileUnmap(&map);
+    }
+
+    if (!buffer) {
+        buffer = bufferFromFile(config, infile);
+    }
+
+    return buffer;
+}
+
+/**
+ * Create a buffer from a range of samples of a WAVE file, only the audio
+ * data of the range is read. For IMA4 ADPCM the range is extended to whole
+ * blocks, see wavInfoSetRange.
+ *
+ * @param config the handle to the driver used to create the buffer
+ * @param infile the WAVE file to load
+ * @param start the first sample per track of the range
+ * @param length the number of samples per track, 0 for up to the end
+ *
+ * Returns NULL if the file is not a WAVE file or could not be loaded.
+ */
+aaxBuffer
+bufferFromFileRange(aaxConfig config, const char *infile, uint64_t start,
+                    uint64_t length)
+{
+    aaxBuffer buffer = NULL;
+    struct wavinfo_t info;
+    _riff_iter_t it;
+    struct stat st;
+    int fd;
+
+    fd = open(infile, O_RDONLY|O_BINARY);
+    if (fd < 0) return buffer;
+
+    it.fd = fd;
+    it.data = NULL;
+    it.head_len = 0;
+    it.size = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    if (_wav_parse(&it, &info) && info.block)
+    {
+        wavInfoSetRange(&info, start, length);
+        if (info.data_size && info.data_size <= (size_t)-1)
+        {
+            size_t len = info.data_size, pos = 0;
+            uint8_t *data = malloc(len);
+
+            if (data && lseek(fd, (off_t)info.data_offset, SEEK_SET) >= 0)
+            {
+                while (pos < len)
+                {
+                    ssize_t res = read(fd, data+pos, len-pos);
+                    if (res > 0) pos += res;
+                    else if (res == 0 || errno != EINTR) break;
+                }
+                if (pos == len) {
+                    buffer = _bufferFromWaveData(config, data, &info);
+                }
+            }
+            free(data);
+        }
+    }
+    close(fd);
+
+    return buffer;
+}
+
+/*
+ * Streaming reader: a background thread reads the data chunk ahead into a
+ * ring of fixed size blocks so files larger than memory can be processed
+ * in bounded memory.
+ */
+#define WAVSTREAM_BLOCK_SIZE	65536
+#define WAVSTREAM_NUM_BLOCKS	4
+
+struct wavstream_t
+{
+    int fd;
+    struct wavinfo_t info;
+    uint64_t remain;		/* bytes of the data chunk left to read */
+
+    uint8_t *ring;
+    size_t *length;		/* number of valid bytes per block */
+    size_t block_size;
+    unsigned int num_blocks;
+
+    _aaxThread thread;
+    _aaxMutex mutex;
+    _aaxCondition cond;
+    unsigned int head;		/* next block to fill */
+    unsigned int tail;		/* next block to hand out */
+    unsigned int count;		/* filled blocks, including the one in use */
+    char threaded;
+    char held;			/* the tail block is in use by the caller */
+    char eof;
+    char error;
+    char stop;
+};
+
+/* Fill the head block from the file, must be called with the mutex locked */
+static void
+_wavStreamFill(struct wavstream_t *s)
+{
+    unsigned int idx = s->head;
+    uint8_t *ptr = s->ring + idx*s->block_size;
+    size_t len = _MIN(s->block_size, s->remain);
+    size_t pos = 0;
+
+    /* the head block is not visible to the reader until count is raised */
+    _aaxMutexUnLock(&s->mutex);
+    while (pos < len)
+    {
+        ssize_t res = read(s->fd, ptr+pos, len-pos);
+        if (res > 0) pos += res;
+        else if (res == 0 || errno != EINTR) break;
+    }
+    _aaxMutexLock(&s->mutex);
+
+    if (pos < len) {
+        s->error = AAX_TRUE;
+    }
+    else if (len == 0) {
+        s->eof = AAX_TRUE;
+    }
+    else
+    {
+        s->remain -= len;
+        s->length[idx] = len;
+        s->head = (idx + 1) % s->num_blocks;
+        s->count++;
+    }
+}
+
+static void*
+_wavStreamThread(void *id)
+{
+    struct wavstream_t *s = (struct wavstream_t*)id;
+
+    _aaxMutexLock(&s->mutex);
+    while (!s->stop && !s->eof && !s->error)
+    {
+        if (s->count < s->num_blocks) {
+            _wavStreamFill(s);
+        }
+        else {
+            _aaxConditionWait(&s->cond, &s->mutex);
+        }
+        _aaxConditionSignal(&s->cond);
+    }
+    _aaxMutexUnLock(&s->mutex);
+
+    return NULL;
+}
+
+/**
+ * Open a WAVE, RF64 or BW64 file for streaming. At most block_size*num_blocks
+ * bytes of audio data are kept in memory, regardless of the file size.
+ *
+ * @param a pointer to the exact ascii file location
+ * @param info the returned audio format and data chunk information
+ * @param block_size the size of the blocks returned by wavStreamRead in bytes,
+ *        rounded down to a multiple of the block alignment. 0 for the default
+ * @param num_blocks the number of blocks to read ahead, 0 for the default
+ *
+ * Returns NULL if the file could not be opened or is not a WAVE file.
+ */
+struct wavstream_t *
+wavStreamOpen(const char *file, struct wavinfo_t *info, size_t block_size,
+              unsigned int num_blocks)
+{
+    return wavStreamOpenRange(file, info, block_size, num_blocks, 0, 0);
+}
+
+/**
+ * Like wavStreamOpen but only stream a range of samples of the file, the
+ * returned info describes the range. For IMA4 ADPCM the range is extended
+ * to whole blocks, see wavInfoSetRange.
+ *
+ * @param start the first sample per track of the range
+ * @param length the number of samples per track, 0 for up to the end
+ */
+struct wavstream_t *
+wavStreamOpenRange(const char *file, struct wavinfo_t *info,
+                   size_t block_size, unsigned int num_blocks,
+                   uint64_t start, uint64_t length)
+{
+    struct wavstream_t *s;
+    _riff_iter_t it;
+    struct stat st;
 
-    fd = open(file, O_RDONLY);
-    if (fd < 0) return 0;
+    s = calloc(1, sizeof(struct wavstream_t));
+    if (!s) return s;
 
-    res = read(fd, &_oalSoftwareWaveHeader, WAVE_EXT_HEADER_SIZE*4);
-    if (__big_endian)
+    s->fd = open(file, O_RDONLY|O_BINARY);
+    if (s->fd < 0)
     {
-        for (i=0; i<WAVE_EXT_HEADER_SIZE; i++) {
-            _oalSoftwareWaveHeader[i] = BSWAP32(_oalSoftwareWaveHeader[i]);
-        }
+        free(s);
+        return NULL;
     }
 
-#if PRINT_DEBUG_MSG
-    do
+    it.fd = s->fd;
+    it.data = NULL;
+    it.head_len = 0;
+    it.size = (fstat(s->fd, &st) == 0) ? st.st_size : 0;
+    if (_wav_parse(&it, &s->info) && s->info.block && (start || length)) {
+        wavInfoSetRange(&s->info, start, length);
+    }
+    else if (!s->info.block) {
+        s->info.data_size = 0;
+    }
+    if (!s->info.data_size ||
+        lseek(s->fd, (off_t)s->info.data_offset, SEEK_SET) < 0)
     {
-        char *p = (char *)&_oalSoftwareWaveHeader;
-        printf("Load:\n");
-        for (i=0; i<WAVE_EXT_HEADER_SIZE; i++)
-            DEBUG_PRINT(i);
+        close(s->fd);
+        free(s);
+        return NULL;
     }
-    while (0);
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(s->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 #endif
 
-    /* Is it a RIFF file? */
-    if (_oalSoftwareWaveHeader[0] == 0x46464952)              /* RIFF */
+    if (!block_size) block_size = WAVSTREAM_BLOCK_SIZE;
+    if (!num_blocks) num_blocks = WAVSTREAM_NUM_BLOCKS;
+    block_size -= block_size % s->info.block;
+    if (!block_size) block_size = s->info.block;
+
+    s->remain = s->info.data_size;
+    s->block_size = block_size;
+    s->num_blocks = num_blocks;
+    if (block_size <= (size_t)-1/num_blocks) {
+        s->ring = malloc(block_size*num_blocks);
+    }
+    s->length = malloc(num_blocks*sizeof(size_t));
+    if (!s->ring || !s->length)
     {
-        char extfmt;
+        free(s->length);
+        free(s->ring);
+        close(s->fd);
+        free(s);
+        return NULL;
+    }
 
-	// EXTENSIBLE_WAVE_FORMAT?
-        *format = _oalSoftwareWaveHeader[5] & 0xFFFF;
-        extfmt = (*format == 0xFFFE) ? 1 : 0;
+    _aaxMutexInit(&s->mutex);
+    _aaxConditionInit(&s->cond);
 
-        if (_oalSoftwareWaveHeader[2] == 0x45564157 &&	/* WAVE */
-            _oalSoftwareWaveHeader[3] == 0x20746d66)	/* fmt  */
-        {
-            *freq = _oalSoftwareWaveHeader[6];
-            *no_tracks = _oalSoftwareWaveHeader[5] >> 16;
-            *bits_sample = extfmt ? _oalSoftwareWaveHeader[9] >> 16 :
-                                    _oalSoftwareWaveHeader[8] >> 16;
-            *format = extfmt ? _oalSoftwareWaveHeader[11] :
-                               _oalSoftwareWaveHeader[5] & 0xFFFF;
-            blocksz = _oalSoftwareWaveHeader[8] & 0xFFFF;
-#if !_OPENAL_SUPPORT
-            *block = blocksz;
-#endif
+    /* without a reader thread the blocks are read on demand */
+    if (num_blocks > 1) {
+        s->threaded = !_aaxThreadCreate(&s->thread, _wavStreamThread, s);
+    }
+
+    if (info) *info = s->info;
+
+    return s;
+}
+
+/**
+ * Get the next block of audio data. The block stays valid until the next
+ * call to wavStreamRead or wavStreamClose. Only the last block may be
+ * smaller than the block size.
+ *
+ * @param s the stream handle returned by wavStreamOpen
+ * @param block the returned pointer to the audio data
+ *
+ * Returns the number of bytes in the block, 0 at the end of the data
+ * or -1 on a read error.
+ */
+ssize_t
+wavStreamRead(struct wavstream_t *s, const void **block)
+{
+    ssize_t rv = 0;
+
+    _aaxMutexLock(&s->mutex);
+    if (s->held)
+    {
+        s->tail = (s->tail + 1) % s->num_blocks;
+        s->count--;
+        s->held = AAX_FALSE;
+        _aaxConditionSignal(&s->cond);
+    }
+
+    while (!s->count && !s->eof && !s->error)
+    {
+        if (s->threaded) {
+            _aaxConditionWait(&s->cond, &s->mutex);
+        } else {
+            _wavStreamFill(s);
         }
     }
 
-    /* search for the data chunk */
-    lseek(fd, 32L, SEEK_SET);
-    do
+    if (s->count)
     {
-        res = read(fd, buf, 1);
-        if (res > 0)
-        {
-           if (buf[0] == 'd')
-           {
-               res = read(fd, buf+1, 3);
-               if (res > 0 && buf[0] == 'd' && buf[1] == 'a'
-                    && buf[2] == 't' && buf[3] == 'a')
-               {
-                   res = read(fd, &buflen, 4); /* chunk size */
-                   if (__big_endian) buflen = BSWAP32(buflen);
-                   break;
-               }
-           }
-       }
-    }
-    while (1);
-    *no_samples = (buflen * 8) / (*no_tracks * *bits_sample);
+        *block = s->ring + s->tail*s->block_size;
+        rv = s->length[s->tail];
+        s->held = AAX_TRUE;
+    }
+    else if (s->error) {
+        rv = -1;
+    }
+    _aaxMutexUnLock(&s->mutex);
 
-#if PRINT_INFO_MSG
-    do
+    return rv;
+}
+
+void
+wavStreamClose(struct wavstream_t *s)
+{
+    if (s->threaded)
     {
-        float duration;
+        _aaxMutexLock(&s->mutex);
+        s->stop = AAX_TRUE;
+        _aaxConditionSignal(&s->cond);
+        _aaxMutexUnLock(&s->mutex);
+        _aaxThreadJoin(s->thread);
+    }
+    _aaxConditionDestroy(&s->cond);
+    _aaxMutexDestroy(&s->mutex);
 
-        printf("Audio file: %s\n", file);
-        if (buflen < 10240)
-            printf("Size:\t\t\t%i bytes\n", buflen);
-        else
-            printf("Size:\t\t\t%i kb (%u bytes)\n", buflen / 1024, buflen);
-        printf("Sample rate:\t\t%i kHz\n", *freq / 1000);
-        printf("No. tracks:\t\t%i\n", *no_tracks);
-        printf("Bits per sample:\t%i\n", *bits_sample);
+    close(s->fd);
+    free(s->length);
+    free(s->ring);
+    free(s);
+}
 
-        printf("Data format:\t\t");
-        switch (*format)
-        {
-        case 1:
-            printf("PCM\n");
-            break;
-        case 2:
-            printf("Microsoft ADPCM\n");
-            break;
-        case 3:
-            printf("PCM Floating point\n");
-            break;
-        case 6:
-            printf("G.711 a-law\n");
-            break;
-        case 7:
-            printf("G.711 mulaw\n");
-            break;
-        case 17:
-            printf("IMA4 ADPCM\n");
-            break;
-        case 0xfffe:
-            printf("Extensible format (0x%X)\n",
-                   _oalSoftwareWaveHeader[11] >> 16);
-            break;
-        default:
-            printf("unknown (0x%X)\n", *format);
-        }
+/*
+ * The header written by wavHeaderWrite reserves room for a ds64 chunk
+ * using a JUNK chunk, which is turned into a ds64 chunk when the data
+ * does not fit in a 32-bit RIFF file (EBU Tech 3306).
+ */
+#define WAV_DS64_SIZE		28
+#define WAV_FMT_SIZE		16
+#define WAV_HEADER_SIZE		(RIFF_HEADER_SIZE + \
+                                 RIFF_CHUNK_HEADER_SIZE + WAV_DS64_SIZE + \
+                                 RIFF_CHUNK_HEADER_SIZE + WAV_FMT_SIZE + \
+                                 RIFF_CHUNK_HEADER_SIZE)
 
-        printf("Samples per block:\t%i\n", blocksz);
-        printf("No. samples:\t\t%i\n", *no_samples);
+/**
+ * Write a WAVE header at the start of a file for info->data_size bytes of
+ * audio data. To write a file of unknown length, call it with a data_size
+ * of zero before writing the audio data and call it again once all data is
+ * written to patch up the sizes. Files which are larger than 4GB get an
+ * RF64 header. The caller adds the pad byte after an odd sized data chunk.
+ *
+ * @param fd the file descriptor of the output file
+ * @param info the format of the audio data and the size of the data chunk
+ *
+ * Returns the size of the header or 0 on error. The file position is set to
+ * the start of the audio data.
+ */
+size_t
+wavHeaderWrite(int fd, const struct wavinfo_t *info)
+{
+    uint8_t hdr[WAV_HEADER_SIZE];
+    uint64_t riff_size;
+    uint8_t *ptr = hdr;
+    size_t pos = 0;
 
-        duration = (float)(buflen * 8);
-        duration /= (*freq * *no_tracks * *bits_sample);
-        printf("Duration:\t\t%5.3f sec.\n", duration);
-    } while (0);
-#endif
+    riff_size = WAV_HEADER_SIZE - RIFF_CHUNK_HEADER_SIZE + info->data_size +
+                (info->data_size & 1);
 
-    data = malloc(buflen);
-    if (data)
+    memset(hdr, 0, sizeof(hdr));
+    if (riff_size <= 0xFFFFFFFF)
     {
-        buflen = read(fd, data, buflen);
-
-#if _OPENAL_SUPPORT
-        /* OpenAL only, AeonWave does the conversion for us */
-        if (__big_endian && (*bits_sample > 8))
+        _put_le32(ptr, RIFF_CHUNK_RIFF);
+        _put_le32(ptr+4, riff_size);
+        _put_le32(ptr+8, RIFF_CHUNK_WAVE);
+        _put_le32(ptr+12, RIFF_CHUNK_JUNK);
+    }
+    else
+    {
+        _put_le32(ptr, RIFF_CHUNK_RF64);
+        _put_le32(ptr+4, 0xFFFFFFFF);
+        _put_le32(ptr+8, RIFF_CHUNK_WAVE);
+        _put_le32(ptr+12, RIFF_CHUNK_DS64);
+        _put_le64(ptr+20, riff_size);
+        _put_le64(ptr+28, info->data_size);
+        _put_le64(ptr+36, info->no_samples);
+    }
+    _put_le32(ptr+16, WAV_DS64_SIZE);
+    ptr += RIFF_HEADER_SIZE + RIFF_CHUNK_HEADER_SIZE + WAV_DS64_SIZE;
+
+    _put_le32(ptr, RIFF_CHUNK_FMT);
+    _put_le32(ptr+4, WAV_FMT_SIZE);
+    _put_le16(ptr+8, info->format);
+    _put_le16(ptr+10, info->no_tracks);
+    _put_le32(ptr+12, info->freq);
+    _put_le32(ptr+16, info->freq*info->block);
+    _put_le16(ptr+20, info->block);
+    _put_le16(ptr+22, info->bits_sample);
+    ptr += RIFF_CHUNK_HEADER_SIZE + WAV_FMT_SIZE;
+
+    _put_le32(ptr, RIFF_CHUNK_DATA);
+    _put_le32(ptr+4, _MIN(info->data_size, 0xFFFFFFFF));
+
+    if (lseek(fd, 0, SEEK_SET) == 0)
+    {
+        while (pos < sizeof(hdr))
         {
-            uint32_t i, *p = (uint32_t *)data;
-
-            if (*bits_sample == 16)
-            {
-                for(i=0; i < buflen/4; i++) {
-                    p[i] = BSWAP32H(p[i]);
-                }
-                if ((buflen-(buflen/4)*4) > 0)
-                {
-                    i++;
-                    p[i] = BSWAP16(p[i]);
-                }
-            }
-            else if (*bits_sample == 32)
-            {
-                for(i=0; i < buflen/4; i++) {
-                    p[i] = BSWAP32(p[i]);
-                }
-            }
+            ssize_t res = write(fd, hdr+pos, sizeof(hdr)-pos);
+            if (res > 0) pos += res;
+            else if (res == 0 || errno != EINTR) break;
         }
-#endif
     }
-    close(fd);
 
-    return data;
+    return (pos == sizeof(hdr)) ? pos : 0;
 }
 
 
-aaxBuffer
-bufferFromFile(aaxConfig config, const char *infile)
+
+static void
+_setLoadStats(struct loadstats_t *stats, unsigned int files,
+              unsigned int failed, uint64_t bytes, unsigned int threads,
+              _aaxTimer *timer)
 {
-#if 1
-   return aaxBufferReadFromStream(config, infile);
-#else
+    stats->files = files;
+    stats->failed = failed;
+    stats->bytes = bytes;
+    stats->threads = threads;
+    stats->elapsed = _aaxTimerElapsed(timer);
+    if (stats->elapsed > 0.0)
+    {
+        stats->files_per_sec = (files+failed)/stats->elapsed;
+        stats->mb_per_sec = 1e-6*bytes/stats->elapsed;
+    }
+    else {
+        stats->files_per_sec = stats->mb_per_sec = 0.0;
+    }
+}
+
+typedef struct
+{
+    aaxConfig config;
+    const char **paths;
+    aaxBuffer *buffers;
+    int *errors;
+
+    _aaxMutex mutex;
+    unsigned int files;
+    unsigned int failed;
+    uint64_t bytes;
+} _batch_load_t;
+
+static void
+_bufferLoadJob(void *user, unsigned int n, unsigned int worker)
+{
+    _batch_load_t *batch = (_batch_load_t*)user;
     aaxBuffer buffer = NULL;
-    unsigned int fmt, no_samples;
-    enum aaxFormat format;
-    char bps, channels;
-    unsigned block = 1;
-    int res, freq;
-    void *data;
+    struct stat st;
+    int err = 0;
 
-    data = fileLoad(infile, &no_samples,
-#if !_OPENAL_SUPPORT
-                    &block,
-#endif
-                    &freq, &bps, &channels, &fmt);
-    format = getFormatFromFileFormat(fmt, bps);
-    if (data && format != AAX_FORMAT_NONE)
+    if (stat(batch->paths[n], &st) < 0) {
+        err = errno;
+    }
+    else
     {
-        buffer = aaxBufferCreate(config, no_samples, channels, format);
-
-        if (format == AAX_IMA4_ADPCM)
+        buffer = bufferFromFileMapped(batch->config, batch->paths[n]);
+        if (!buffer)
         {
-            bufferConvertMSIMA_IMA4(data, channels, no_samples, &block);
-
-            res = aaxBufferSetSetup(buffer, AAX_BLOCK_ALIGNMENT, block);
-            testForState(res, "aaxBufferSetSetup(AAX_BLOCK_ALIGNMENT)");
+            err = aaxGetErrorNo();
+            if (!err) err = -1;
         }
+    }
 
-        res = aaxBufferSetSetup(buffer, AAX_FREQUENCY, freq);
-        testForState(res, "aaxBufferSetSetup(AAX_FREQUENCY)");
+    batch->buffers[n] = buffer;
+    if (batch->errors) batch->errors[n] = err;
 
-        res = aaxBufferSetData(buffer, data);
-        testForState(res, "aaxBufferSetData");
+    _aaxMutexLock(&batch->mutex);
+    if (buffer)
+    {
+        batch->files++;
+        batch->bytes += st.st_size;
     }
-    free(data);
+    else {
+        batch->failed++;
+    }
+    _aaxMutexUnLock(&batch->mutex);
+}
 
-    return buffer;
-#endif
+/**
+ * Load a list of audio files into buffers using a pool of worker threads.
+ * WAVE files are loaded using bufferFromFileMapped, all other files are
+ * handed to aaxBufferReadFromStream.
+ *
+ * @param config the handle to the (loopback) driver used to create buffers
+ * @param paths the list of file paths to load
+ * @param num the number of files in the list
+ * @param buffers the returned buffers, in the same order as paths,
+ *        NULL for files which failed to load
+ * @param errors the returned per file error code (optional): 0 on success,
+ *        the errno value if the file could not be accessed or the AeonWave
+ *        error number (or -1) if it could not be loaded
+ * @param num_threads the number of worker threads or 0 for one per CPU core
+ * @param stats the returned throughput statistics (optional)
+ *
+ * Returns the number of successfully loaded files.
+ */
+unsigned int
+buffersFromFiles(aaxConfig config, const char **paths, unsigned int num,
+                 aaxBuffer *buffers, int *errors, unsigned int num_threads,
+                 struct loadstats_t *stats)
+{
+    _batch_load_t batch;
+    _aaxTimer timer;
+
+    batch.config = config;
+    batch.paths = paths;
+    batch.buffers = buffers;
+    batch.errors = errors;
+    batch.files = 0;
+    batch.failed = 0;
+    batch.bytes = 0;
+    _aaxMutexInit(&batch.mutex);
+
+    _aaxTimerStart(&timer);
+    num_threads = _aaxParallelFor(num_threads, num, _bufferLoadJob, &batch);
+
+    if (stats) {
+        _setLoadStats(stats, batch.files, batch.failed, batch.bytes,
+                      num_threads, &timer);
+    }
+    _aaxMutexDestroy(&batch.mutex);
+
+    return batch.files;
 }
 
+typedef struct
+{
+    struct probeinfo_t *list;
+} _batch_probe_t;
+
+static void
+_fileProbeJob(void *user, unsigned int n, unsigned int worker)
+{
+    _batch_probe_t *batch = (_batch_probe_t*)user;
+    struct probeinfo_t *entry = &batch->list[n];
+
+    entry->error = fileProbe(entry->path, &entry->info, &entry->file_size);
+}
 
 /**
- * process a canonical WAVE file in memory and return a pointer to the buffer.
+ * Probe all WAVE files (.wav, .wave, .rf64 and .bw64) in a directory and
+ * its subdirectories using a pool of worker threads. Only the headers of
+ * the files are read.
  *
- * @param a pointer to the wave file buffer
- * @ve file param no_samples the returned number of samples per audio track
- * @param freq the returned sample frequency of the audio tracks
- * @param bits_sample the returned number of bits per sample
- * @param no_tracks the returned number of audio tracks in the buffer
+ * @param path the directory to scan, or a single file
+ * @param num_threads the number of worker threads or 0 for one per CPU core
+ * @param num the returned number of entries in the list
+ * @param stats the returned throughput statistics (optional), bytes is the
+ *        combined size of the scanned files
+ *
+ * Returns a list of num entries, sorted by path, which should be freed
+ * using dirProbeFree. Files which could not be probed have a non zero
+ * error code, see fileProbe.
  */
-void*
-dataLoad(const unsigned char *data, unsigned int *no_samples,
-#if !_OPENAL_SUPPORT
-         unsigned *block,
-#endif
-         int *freq, char *bits_sample, char *no_tracks, unsigned int *format)
+struct probeinfo_t *
+dirProbe(const char *path, unsigned int num_threads, unsigned int *num,
+         struct loadstats_t *stats)
 {
-    static const unsigned int _t = 1;
-    unsigned int buflen, blocksz;
-    char *ptr = (char*)data;
-    int i;
-
-#if !_OPENAL_SUPPORT
-    *block = 1;
-#endif
+    struct probeinfo_t *list = NULL;
+    _batch_probe_t batch;
+    unsigned int i, n = 0;
+    _aaxTimer timer;
+    char **files;
 
-    __big_endian = (*(char *)&_t == 0);
+    _aaxTimerStart(&timer);
 
-    memcpy(&_oalSoftwareWaveHeader, ptr, WAVE_EXT_HEADER_SIZE*4);
-    if (__big_endian)
+    files = getFileList(path, "wav,wave,rf64,bw64", &n);
+    if (n) list = calloc(n, sizeof(struct probeinfo_t));
+    if (list)
     {
-        for (i=0; i<WAVE_EXT_HEADER_SIZE; i++) {
-            _oalSoftwareWaveHeader[i] = BSWAP32(_oalSoftwareWaveHeader[i]);
+        for (i=0; i<n; ++i) {
+            list[i].path = files[i];
         }
-    }
+        free(files);
 
-    *freq = _oalSoftwareWaveHeader[6];
-    *no_tracks = _oalSoftwareWaveHeader[5] >> 16;
-    *format = _oalSoftwareWaveHeader[5] & 0xFFFF;
-    *bits_sample = _oalSoftwareWaveHeader[8] >> 16;
-    blocksz = _oalSoftwareWaveHeader[8] & 0xFFFF;
-#if !_OPENAL_SUPPORT
-    *block = blocksz;
-#endif
+        batch.list = list;
+        num_threads = _aaxParallelFor(num_threads, n, _fileProbeJob, &batch);
+    }
+    else
+    {
+        if (files) freeFileList(files, n);
+        n = num_threads = 0;
+    }
 
-    /* search for the data chunk */
-    ptr += 32L;
-    do
+    if (stats)
     {
-        if (*ptr++ == 'd' && *ptr++ == 'a' && *ptr++ == 't' && *ptr++ == 'a')
+        unsigned int failed = 0;
+        uint64_t bytes = 0;
+
+        for (i=0; i<n; ++i)
         {
-            memcpy(&buflen, ptr, 4);
-            ptr += 4;
-            break;
+            if (list[i].error) failed++;
+            bytes += list[i].file_size;
         }
+        _setLoadStats(stats, n-failed, failed, bytes, num_threads, &timer);
     }
-    while (1);
-    *no_samples = (buflen * 8) / (*no_tracks * *bits_sample);
 
-    return ptr;
+    *num = n;
+    return list;
 }
 
-
-aaxBuffer
-bufferFromData(aaxConfig config, const unsigned char *indata)
+void
+dirProbeFree(struct probeinfo_t *list, unsigned int num)
 {
-    aaxBuffer buffer = NULL;
-    unsigned int fmt, no_samples;
-    enum aaxFormat format;
-    char bps, channels;
-    unsigned block = 1;
-    int res, freq;
-    void *data;
-
-    data = dataLoad(indata, &no_samples,
-#if !_OPENAL_SUPPORT
-                    &block,
-#endif
-                    &freq, &bps, &channels, &fmt);
-    format = getFormatFromFileFormat(fmt, bps);
-    if (data && format != AAX_FORMAT_NONE)
-    {
-        void *ptr = data;
-
-        buffer = aaxBufferCreate(config, no_samples, channels, format);
-
-        if (format == AAX_IMA4_ADPCM)
-        {
-            unsigned int size = channels*no_samples*bps/8;
-
-            ptr = malloc(size);
-            memcpy(ptr, data, size);
-            bufferConvertMSIMA_IMA4(ptr, channels, no_samples, &block);
-
-            res = aaxBufferSetSetup(buffer, AAX_BLOCK_ALIGNMENT, block);
-            testForState(res, "aaxBufferSetSetup(AAX_BLOCK_ALIGNMENT)");
-        }
-
-        res = aaxBufferSetSetup(buffer, AAX_FREQUENCY, freq);
-        testForState(res, "aaxBufferSetSetup(AAX_FREQUENCY)");
+    unsigned int i;
 
-        res = aaxBufferSetData(buffer, ptr);
-        testForState(res, "aaxBufferSetData");
- 
-        if (ptr != data) free(ptr);
+    for (i=0; i<num; ++i) {
+        free(list[i].path);
     }
-
-    return buffer;
+    free(list);
 }
 
-
 #define REFRESH_RATE		250
 
 int
@@ -468,34 +1593,33 @@ void *
 fileDataConvertToInterleaved(void *sbuf, char no_tracks, char bits_sample,
                              unsigned int no_samples)
 {
-    const unsigned int tracklen_bytes = no_samples*bits_sample;
     void *dbuf;
-    
-    dbuf = malloc(no_tracks * tracklen_bytes);
-    if (dbuf && (no_tracks == 1)) {
-        memcpy(dbuf, sbuf, tracklen_bytes);
+
+    dbuf = malloc(no_tracks * no_samples * bits_sample);
+    if (dbuf) {
+        _aax_interleave(dbuf, sbuf, no_tracks, bits_sample, no_samples);
     }
-    else if (dbuf)
-    {
-        unsigned int frame_size = no_tracks*bits_sample;
-        uint8_t *sptr, *dptr;
-        int t;
 
-        sptr = sbuf;
-        for (t=0; t<no_tracks; t++)
-        {
-            unsigned int i;
+    return dbuf;
+}
 
-            dptr = dbuf;
-            dptr += t*bits_sample;
+/**
+ * Convert asound buffer from interleaved to separated multichannel format.
+ *
+ * @param in data input buffer
+ * @param no_tracks the number of audio tracks in the buffer
+ * @param bits_sample bytes per sample for the emitter buffer
+ * @param no_samples number of samples per audio track
+ */
+void *
+fileDataConvertFromInterleaved(void *sbuf, char no_tracks, char bits_sample,
+                               unsigned int no_samples)
+{
+    void *dbuf;
 
-            for (i=0; i<no_samples; i++)
-            {
-                memcpy(dptr, sptr, bits_sample);
-                sptr += bits_sample;
-                dptr += frame_size;
-            }
-        }
+    dbuf = malloc(no_tracks * no_samples * bits_sample);
+    if (dbuf) {
+        _aax_deinterleave(dbuf, sbuf, no_tracks, bits_sample, no_samples);
     }
 
     return dbuf;
@@ -535,42 +1659,119 @@ getFormatFromFileFormat(unsigned int format, int  bps)
     return rv;
 }
 
-void
-bufferConvertMSIMA_IMA4(void *data, unsigned channels, unsigned int no_samples, unsigned *blocksz)
+/*
+ * MS-IMA ADPCM blocks start with a 4 byte header for every channel followed
+ * by 4 byte chunks of samples for every channel in turn. AeonWave expects
+ * the header and all chunks of one channel to be stored consecutively, so
+ * every block is a chunks x channels matrix of 32-bit words which needs to
+ * be transposed. That is what _aax_deinterleave does for 4 byte samples.
+ */
+#define IMA4_SCRATCH_SIZE	8192
+
+static void
+_ima4_block_copy(int32_t *dptr, const int32_t *sptr, unsigned int channels,
+                 unsigned int chunks)
 {
-    unsigned int blocksize = *blocksz;
-    int32_t* buf;
+    _aax_deinterleave(dptr, sptr, channels, sizeof(int32_t), chunks);
+}
 
-    if (channels < 2) return;
+/*
+ * In place transposition by following the cycles of the permutation,
+ * only used for blocks which do not fit in the scratch buffer.
+ * Word k = i*channels + t moves to t*chunks + i = k*chunks mod (n-1)
+ */
+static void
+_ima4_block_transpose(int32_t *data, unsigned int channels,
+                      unsigned int chunks)
+{
+    const size_t n = (size_t)channels*chunks;
+    size_t start;
 
-    buf = malloc(blocksize);
-    if (buf)
+    for (start=1; start+1 < n; start++)
     {
-        unsigned b, blocks, block_bytes, chunks;
-        int32_t* dptr = (int32_t*)data;
+        size_t k = start;
+        int32_t v;
 
-        blocks = no_samples/blocksize;
-        block_bytes = blocksize/channels;
-        chunks = block_bytes/sizeof(int32_t);
+        /* only move a cycle starting at its lowest index */
+        do {
+            k = (k*chunks) % (n-1);
+        } while (k > start);
+        if (k < start) continue;
 
-        for (b=0; b<blocks; b++)
+        v = data[start];
+        do
         {
-            unsigned int t, i;
+            int32_t tmp;
 
-            /* block shuffle */
-            memcpy(buf, dptr, blocksize);
-            for (t=0; t<channels; t++)
-            {
-                int32_t* src = (int32_t*)buf + t;
-                for (i=0; i<chunks; i++)
-                {
-                    *dptr++ = *src;
-                    src += channels;
-                }
-            }
+            k = (k*chunks) % (n-1);
+            tmp = data[k];
+            data[k] = v;
+            v = tmp;
+        }
+        while (k != start);
+    }
+}
+
+static void
+_ima4_convert(int32_t *dptr, const int32_t *sptr, unsigned int channels,
+              unsigned int no_samples, unsigned int blocksize)
+{
+    const size_t size = (size_t)no_samples*channels/2;
+    const size_t blocks = size/blocksize;
+    const unsigned int chunks = blocksize/channels/sizeof(int32_t);
+    const unsigned int words = blocksize/sizeof(int32_t);
+    int32_t scratch[IMA4_SCRATCH_SIZE/sizeof(int32_t)];
+    size_t b;
+
+    for (b=0; b<blocks; b++)
+    {
+        if (dptr != sptr) {
+            _ima4_block_copy(dptr, sptr, channels, chunks);
+        }
+        else if (blocksize <= IMA4_SCRATCH_SIZE)
+        {
+            memcpy(scratch, sptr, channels*chunks*sizeof(int32_t));
+            _ima4_block_copy(dptr, scratch, channels, chunks);
         }
-        free(buf);
-        *blocksz = block_bytes;
+        else {
+            _ima4_block_transpose(dptr, channels, chunks);
+        }
+        dptr += words;
+        sptr += words;
+    }
+
+    /* a trailing partial block is passed on unmodified */
+    if (dptr != sptr) {
+        memcpy(dptr, sptr, size - blocks*blocksize);
     }
 }
 
+/*
+ * Convert MS-IMA ADPCM to IMA4 in place, without memory allocation.
+ * blocksz is set to the block size per channel on return.
+ */
+void
+bufferConvertMSIMA_IMA4(void *data, unsigned channels, unsigned int no_samples, unsigned *blocksz)
+{
+    if (channels < 2) return;
+
+    _ima4_convert(data, data, channels, no_samples, *blocksz);
+    *blocksz /= channels;
+}
+
+/*
+ * Like bufferConvertMSIMA_IMA4 but reads the MS-IMA data from src, which
+ * may be read-only, and writes the result to dst in a single pass.
+ */
+void
+bufferCopyMSIMA_IMA4(void *dst, const void *src, unsigned channels, unsigned int no_samples, unsigned *blocksz)
+{
+    if (channels < 2)
+    {
+        memcpy(dst, src, (size_t)no_samples*channels/2);
+        return;
+    }
+
+    _ima4_convert(dst, src, channels, no_samples, *blocksz);
+    *blocksz /= channels;
+}
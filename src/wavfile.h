@@ -37,18 +37,81 @@ extern "C" {
 #endif
 
 #include <aax/aax.h>
+#include <base/types.h>
 
 #define _OPENAL_SUPPORT		0
 
+struct mmap_t;
+struct wavstream_t;
+
+/* WAVE file information, filled in by the *Info functions */
+struct wavinfo_t {
+    unsigned int format;	/* WAVE format tag */
+    unsigned int no_tracks;
+    unsigned int freq;
+    unsigned int bits_sample;
+    unsigned int block;		/* block alignment in bytes */
+    uint64_t no_samples;	/* number of samples per track */
+    uint64_t data_offset;	/* file offset of the audio data */
+    uint64_t data_size;		/* size of the audio data in bytes */
+};
+
+/* throughput statistics of a batch load, see buffersFromFiles */
+struct loadstats_t {
+    unsigned int files;		/* number of successfully loaded files */
+    unsigned int failed;	/* number of files which failed to load */
+    unsigned int threads;	/* number of worker threads used */
+    uint64_t bytes;		/* combined size of the loaded files */
+    double elapsed;		/* wall clock time in seconds */
+    double files_per_sec;
+    double mb_per_sec;
+};
+
+/* the result of probing a single file, see dirProbe */
+struct probeinfo_t {
+    char *path;
+    struct wavinfo_t info;
+    uint64_t file_size;
+    int error;			/* 0 on success, see fileProbe */
+};
+
 int playAudioTune(int argc, char **argv);
 aaxBuffer bufferFromData(aaxConfig, const unsigned char *);
+aaxBuffer bufferFromBlob(aaxConfig, const void *, size_t);
 aaxBuffer bufferFromFile(aaxConfig, const char *);
+aaxBuffer bufferFromFileMapped(aaxConfig, const char *);
+aaxBuffer bufferFromFileRange(aaxConfig, const char *, uint64_t, uint64_t);
+unsigned int buffersFromFiles(aaxConfig, const char **, unsigned int, aaxBuffer *, int *, unsigned int, struct loadstats_t *);
 void *fileLoad(const char *, unsigned int *, unsigned *, int *, char *, char *, unsigned int *);
+void *fileMap(const char *, struct mmap_t *, unsigned int *, unsigned *, int *, char *, char *, unsigned int *);
+void fileUnmap(struct mmap_t *);
+
+/* reentrant versions which keep all state in the wavinfo_t structure */
+void *fileLoadInfo(const char *, struct wavinfo_t *);
+void *fileMapInfo(const char *, struct mmap_t *, struct wavinfo_t *);
+void *dataLoadInfo(const unsigned char *, struct wavinfo_t *);
+void *dataLoadInfoSize(const void *, size_t, struct wavinfo_t *);
+
+/* header-only probing of single files and (parallel) directory scans */
+int fileProbe(const char *, struct wavinfo_t *, uint64_t *);
+uint64_t wavInfoSetRange(struct wavinfo_t *, uint64_t, uint64_t);
+struct probeinfo_t *dirProbe(const char *, unsigned int, unsigned int *, struct loadstats_t *);
+void dirProbeFree(struct probeinfo_t *, unsigned int);
+
+/* bounded memory streaming of (64-bit) WAVE files, see wavStreamOpen */
+struct wavstream_t *wavStreamOpen(const char *, struct wavinfo_t *, size_t, unsigned int);
+struct wavstream_t *wavStreamOpenRange(const char *, struct wavinfo_t *, size_t, unsigned int, uint64_t, uint64_t);
+ssize_t wavStreamRead(struct wavstream_t *, const void **);
+void wavStreamClose(struct wavstream_t *);
+size_t wavHeaderWrite(int, const struct wavinfo_t *);
 #define fileWrite(a, b, c, d, e, f) \
         aaxWritePCMToFile(a, b, c, d, e, f)
 
 void *fileDataConvertToInterleaved(void *, char, char, unsigned int);
+void *fileDataConvertFromInterleaved(void *, char, char, unsigned int);
 enum aaxFormat getFormatFromFileFormat(unsigned int, int);
+void bufferConvertMSIMA_IMA4(void *, unsigned, unsigned int, unsigned *);
+void bufferCopyMSIMA_IMA4(void *, const void *, unsigned, unsigned int, unsigned *);
 
 #if defined(__cplusplus)
 }